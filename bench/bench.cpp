@@ -0,0 +1,914 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "clock.hpp"
+#include "dsp.hpp"
+#include "engines.hpp"
+#include "midi_sync.hpp"
+#include "mix.hpp"
+#include "patterns.hpp"
+#include "project.hpp"
+#include "reverb.hpp"
+#include "rt_thread.hpp"
+#include "rtcheck.hpp"
+#include <stmlib/utils/random.h>
+
+enum bench_format {
+	BF_TABLE,
+	BF_CSV,
+	BF_JSON
+};
+
+struct bench_result {
+	std::string name;
+	double ns_per_sample;
+};
+
+struct bench_options {
+	bench_format format = BF_TABLE;
+	double seconds = 2.0; // audio seconds rendered per case
+	int threads = 0;	  // worker threads for the parallel full case
+	bool stress_params = false;
+	bool project = false;
+	bool midi = false;
+};
+
+// runs fn() until `samples` samples have been processed, `samples_per_call` at a time,
+// and returns the average cost of one sample in nanoseconds.
+template <typename F>
+static double time_per_sample(long samples, int samples_per_call, F&& fn)
+{
+	// warm up caches and let plaits settle after engine changes
+	for (int i = 0; i < 64; i++) fn();
+
+	const long calls = samples / samples_per_call;
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < calls; i++) fn();
+	auto end = std::chrono::steady_clock::now();
+
+	const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+	return ns / (calls * samples_per_call);
+}
+
+static void bench_engines(const bench_options& o, std::vector<bench_result>& results)
+{
+	const long samples = (long)(o.seconds * SAMPLERATE);
+	// retrigger twice per second, like a busy eighth note pattern at 120 bpm
+	const int trigger_interval = (int)(SAMPLERATE / 2) / PLAITS_BLOCKSIZE;
+
+	arena memory;
+	arena_init(memory, track_voice_memory());
+	track_voice t;
+	track_voice_init(t, memory);
+
+	for (int e = 0; e < (int)engine_names.size(); e++) {
+		t.plaits_patch.engine = e;
+		int block = 0;
+
+		double ns = time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+			t.plaits_mods.trigger = (block++ % trigger_interval == 0) ? 1.f : 0.f;
+			t.voice->Render(t.plaits_patch, t.plaits_mods, t.frames, PLAITS_BLOCKSIZE);
+		});
+
+		results.push_back({"engine/" + engine_names[e], ns});
+	}
+}
+
+static void bench_stages(const bench_options& o, std::vector<bench_result>& results)
+{
+	const long samples = (long)(o.seconds * SAMPLERATE);
+
+	auto dsp = std::make_shared<flechtbox_dsp>();
+	dsp_init(dsp);
+
+	// fill the voice outputs with something that isn't silence
+	for (auto& p : dsp->params->tracks) {
+		p.reverb_send_amt = 0.5f;
+		p.delay_send_amt = 0.5f;
+	}
+	for (auto& t : dsp->tracks) {
+		for (int i = 0; i < PLAITS_BLOCKSIZE; i++) {
+			t.voices[0].frames[i].out = (short)(rand() % 65536 - 32768);
+			t.voices[0].frames[i].aux = t.voices[0].frames[i].out;
+		}
+	}
+
+	results.push_back(
+		{"stage/mix", time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+			 dsp_mix_tracks(*dsp);
+		 })});
+
+	std::vector<float> out(PLAITS_BLOCKSIZE * 2);
+	results.push_back({"stage/output", time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+						   dsp_write_output(*dsp, out.data());
+					   })});
+
+	// the reverb works in place, so the mixed send is restored before every call.
+	// otherwise it would be fed its own decaying output and end up timing denormals.
+	dsp_mix_tracks(*dsp);
+	float** reverb_io = dsp->reverb_buffer.channel_ptrs.data();
+	const std::vector<float> send(reverb_io[0], reverb_io[0] + PLAITS_BLOCKSIZE);
+	auto restore_send = [&] {
+		std::copy(send.begin(), send.end(), reverb_io[0]);
+		std::copy(send.begin(), send.end(), reverb_io[1]);
+	};
+
+	results.push_back({"stage/reverb_12bit", time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+						   restore_send();
+						   clouds_reverb_process(dsp->reverb, reverb_io, PLAITS_BLOCKSIZE);
+					   })});
+
+	arena reverb_memory;
+	arena_init(reverb_memory, float_reverb_memory(PLAITS_BLOCKSIZE));
+	float_reverb_init(dsp->reverb_float, PLAITS_BLOCKSIZE, SAMPLERATE, reverb_memory);
+	results.push_back({"stage/reverb_float", time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+						   restore_send();
+						   float_reverb_process(dsp->reverb_float, reverb_io,
+												PLAITS_BLOCKSIZE);
+					   })});
+
+	// an eighth at 120 bpm, adding to the restored send
+	float* delay_send = dsp->delay_buffer.channel_ptrs[0];
+	float_delay_set_time(dsp->delay, 0.25f);
+	results.push_back({"stage/delay", time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+						   restore_send();
+						   float_delay_process(dsp->delay, delay_send, reverb_io,
+											   PLAITS_BLOCKSIZE);
+					   })});
+
+	// only the filter, per output sample, fed from the mixed send instead of the synth
+	auto fill_send = [](void* ctx, float* out, int frames) {
+		const float* send = static_cast<const float*>(ctx);
+		for (int i = 0; i < frames; i++) out[i * 2] = out[i * 2 + 1] = send[i];
+	};
+	const double resample_rates[] = {44100, 96000};
+	const char* resample_names[] = {"stage/resample_44k1", "stage/resample_96k"};
+	for (int i = 0; i < 2; i++) {
+		resampler rs;
+		resampler_init(rs, SAMPLERATE, resample_rates[i], PLAITS_BLOCKSIZE);
+		results.push_back({resample_names[i], time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+							   resampler_process(rs, out.data(), PLAITS_BLOCKSIZE, fill_send,
+												 (void*)send.data());
+						   })});
+	}
+
+	dsp->clock.running = true;
+	results.push_back({"stage/clock", time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+						   clock_process_block(dsp->clock, PLAITS_BLOCKSIZE);
+					   })});
+
+	// the draws of a sub-block in which every track lands on a step with a chance of
+	// one in two, with mt19937 and the distributions as the sequencer used to, and with
+	// a pcg32 per track. the sums keep the draws from being optimized away.
+	std::mt19937 mt(1);
+	float sum = 0.f;
+	results.push_back(
+		{"stage/triggers_mt19937", time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+			 for (int t = 0; t < dsp->num_tracks; t++) {
+				 if (std::uniform_int_distribution<int>(0, 100)(mt) >= 50) continue;
+				 std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+				 sum += dist(mt) + dist(mt) + dist(mt);
+			 }
+		 })});
+	results.push_back(
+		{"stage/triggers_pcg32", time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+			 for (auto& t : dsp->tracks) {
+				 if (!rng_chance(t.rng, 50)) continue;
+				 sum += rng_bipolar(t.rng) + rng_bipolar(t.rng) + rng_bipolar(t.rng);
+			 }
+		 })});
+	if (sum == 12345.f) printf("\n");
+}
+
+// the mix loop as it was before it got vectorized: per sample and per track, with the
+// float conversion, gains and soft clip done one sample at a time
+static float soft_clip_branching(float x)
+{
+	if (x < -3.f) return -1.f;
+	if (x > 3.f) return 1.f;
+	return x * (27.f + x * x) / (27.f + 9.f * x * x);
+}
+
+static void mix_reference(flechtbox_dsp& dsp, float* out)
+{
+	for (int i = 0; i < PLAITS_BLOCKSIZE; i++) {
+		float mix_send = 0.f;
+		float reverb_send = 0.f;
+		for (int t = 0; t < dsp.num_tracks; t++) {
+			auto& track = dsp.tracks[t].voices[0];
+			const auto& p = dsp.params->tracks[t];
+			float voice_out =
+				track.frames[i].out / 32768.0f * track.current_velocity * p.volume;
+			mix_send += voice_out;
+			reverb_send += voice_out * p.reverb_send_amt;
+		}
+		*out++ = soft_clip_branching(mix_send + reverb_send);
+		*out++ = soft_clip_branching(mix_send + reverb_send);
+	}
+}
+
+// times the mix bus, voices to interleaved output without the reverb in between, with
+// the old loop and every implementation the cpu supports. all implementations have to
+// produce the same output.
+static bool bench_mix(const bench_options& o, std::vector<bench_result>& results)
+{
+	const long samples = (long)(o.seconds * SAMPLERATE);
+
+	auto dsp = std::make_shared<flechtbox_dsp>();
+	dsp_init(dsp);
+
+	for (auto& p : dsp->params->tracks) p.reverb_send_amt = 0.5f;
+	for (auto& t : dsp->tracks) {
+		for (int i = 0; i < PLAITS_BLOCKSIZE; i++) {
+			t.voices[0].frames[i].out = (short)(rand() % 65536 - 32768);
+			t.voices[0].frames[i].aux = (short)(rand() % 65536 - 32768);
+		}
+	}
+
+	std::vector<float> out(PLAITS_BLOCKSIZE * 2);
+	results.push_back({"mix/reference", time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+						   mix_reference(*dsp, out.data());
+					   })});
+
+	const mix_impl best = mix_selected();
+	std::vector<float> first;
+	bool identical = true;
+
+	for (int impl = 0; impl < MIX_NUM_IMPLS; impl++) {
+		if (!mix_select((mix_impl)impl)) continue;
+
+		results.push_back({std::string("mix/") + mix_impl_name((mix_impl)impl),
+						   time_per_sample(samples, PLAITS_BLOCKSIZE, [&] {
+							   dsp_mix_tracks(*dsp);
+							   dsp_write_output(*dsp, out.data());
+						   })});
+
+		if (first.empty()) first = out;
+		else if (out != first) identical = false;
+	}
+	mix_select(best);
+
+	if (!identical) fprintf(stderr, "mix implementations produce different output\n");
+	return identical;
+}
+
+enum bench_pattern {
+	BP_DENSE,  // every step of every track triggers
+	BP_SPARSE, // one step in ten per track, spread over the tracks
+	BP_RANDOM  // every step has a chance of one in two, random playback and settings
+};
+
+// returns ns/sample and leaves the rendered audio in `out`. with odd_buffers the host
+// buffer size keeps changing between sizes that don't divide 16. locked locks every
+// target on every step, the engine to a different one from step to step.
+static double render_pattern(const bench_options& o, bench_pattern pattern, int threads,
+							 bool skip_silent, std::vector<float>& out,
+							 bool odd_buffers = false, bool locked = false, int seed = 1)
+{
+	const long samples = (long)(o.seconds * SAMPLERATE) / BLOCKSIZE * BLOCKSIZE;
+
+	auto dsp = std::make_shared<flechtbox_dsp>();
+	dsp->num_workers = threads;
+	dsp->skip_silent = skip_silent;
+	dsp_init(dsp);
+	dsp->params->master.running = true;
+	dsp->params->master.seed = seed;
+
+	// alternate between engines that can go to the workers and ones that can't, the
+	// arpeggiator and an fm engine among the latter
+	for (int i = 0; i < dsp->num_tracks; i++) {
+		auto& p = dsp->params->tracks[i];
+		switch (pattern) {
+		case BP_DENSE:
+			p.sequence.data.fill(100);
+			break;
+		case BP_SPARSE:
+			p.sequence.data.fill(0);
+			p.sequence.data[i % NUM_STEPS] = 100;
+			break;
+		case BP_RANDOM:
+			p.sequence.data.fill(50);
+			p.sequence.playback_dir = PB_RANDOM;
+			p.harmonics_rand_amt = 0.5f;
+			p.timbre_rand_amt = 0.5f;
+			p.morph_rand_amt = 0.5f;
+			break;
+		}
+		p.reverb_send_amt = 0.3f;
+		p.delay_send_amt = 0.2f;
+		p.engine = (i * 7) % engine_names.size();
+
+		if (!locked) continue;
+		for (int s = 0; s < NUM_STEPS; s++) {
+			const int engine = (p.engine + s * 7) % engine_names.size();
+			p.locks.mask[s] = (1u << PL_NUM_TARGETS) - 1;
+			p.locks.values[s] = {s / 10.f, 1.f - s / 10.f, (s % 3) / 3.f, 0.2f,
+								 (float)engine};
+		}
+	}
+
+	// same noise sequence for every run
+	stmlib::Random::Seed(0x21);
+
+	static const int odd_sizes[] = {1, 37, 48, 333, 7, 64, 129};
+	int size_index = 0;
+
+	out.assign(samples * 2, 0.f);
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < samples;) {
+		int n = odd_buffers ? odd_sizes[size_index++ % 7] : BLOCKSIZE;
+		n = (int)std::min<long>(n, samples - i);
+		dsp_process_block(dsp, out.data() + i * 2, n);
+		i += n;
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / samples;
+}
+
+// a note landing on the last sample of a sub-block, on a voice that went silent, has
+// a single sample in that sub-block, often below SILENCE_THRESHOLD. the voice has to
+// stay awake for the hangover anyway, or the note is cut off right after it started.
+static bool late_note_stays_awake()
+{
+	auto dsp = std::make_shared<flechtbox_dsp>();
+	dsp->num_tracks = 1;
+	dsp_init(dsp);
+
+	// the lowest note barely moves away from zero in its first sample
+	auto& t = dsp->tracks[0];
+	t.pending.countdown = CLOCK_LOOKAHEAD;
+	t.pending.offset = PLAITS_BLOCKSIZE - 1;
+	t.pending.note = 0.f;
+	t.pending.voice = 0;
+
+	// the note lands in sub-block CLOCK_LOOKAHEAD - 1
+	for (int b = 0; b < CLOCK_LOOKAHEAD + 32; b++) {
+		dsp_process_tracks(*dsp, dsp->clock);
+		if (b >= CLOCK_LOOKAHEAD - 1 && !t.voices[0].active) return false;
+	}
+	return true;
+}
+
+static bool bench_full(const bench_options& o, std::vector<bench_result>& results)
+{
+	if (!late_note_stays_awake()) {
+		fprintf(stderr, "a note landing at the end of a sub-block went silent\n");
+		return false;
+	}
+
+	std::vector<float> serial_out;
+	std::vector<float> scratch;
+	results.push_back({"full/dense", render_pattern(o, BP_DENSE, 0, true, serial_out)});
+	results.push_back(
+		{"full/dense_no_skip", render_pattern(o, BP_DENSE, 0, false, scratch)});
+
+	// most patterns look like this one, where skipping silent voices pays off
+	results.push_back({"full/sparse", render_pattern(o, BP_SPARSE, 0, true, scratch)});
+	results.push_back(
+		{"full/sparse_no_skip", render_pattern(o, BP_SPARSE, 0, false, scratch)});
+
+	// the same seed has to render the same, another seed something else
+	std::vector<float> random_out;
+	std::vector<float> again_out;
+	results.push_back({"full/random", render_pattern(o, BP_RANDOM, 0, true, random_out)});
+	render_pattern(o, BP_RANDOM, 0, true, again_out);
+	if (again_out != random_out) {
+		fprintf(stderr, "output with the same seed differs\n");
+		return false;
+	}
+	render_pattern(o, BP_RANDOM, 0, true, again_out, false, false, 2);
+	if (again_out == random_out) {
+		fprintf(stderr, "output with another seed is the same\n");
+		return false;
+	}
+
+	// host buffers of any size go through the fifo and have to sound the same
+	std::vector<float> odd_out;
+	results.push_back(
+		{"full/dense_odd_buffers", render_pattern(o, BP_DENSE, 0, true, odd_out, true)});
+	if (odd_out != serial_out) {
+		fprintf(stderr, "output with odd buffer sizes differs\n");
+		return false;
+	}
+
+	// every step of every track locked
+	std::vector<float> locked_out;
+	results.push_back({"full/dense_locked",
+					   render_pattern(o, BP_DENSE, 0, true, locked_out, false, true)});
+
+	if (o.threads <= 0) return true;
+
+	std::vector<float> parallel_out;
+	results.push_back({"full/dense_" + std::to_string(o.threads) + "_threads",
+					   render_pattern(o, BP_DENSE, o.threads, true, parallel_out)});
+
+	if (parallel_out != serial_out) {
+		fprintf(stderr, "parallel output differs from serial output\n");
+		return false;
+	}
+
+	render_pattern(o, BP_RANDOM, o.threads, true, parallel_out);
+	if (parallel_out != random_out) {
+		fprintf(stderr, "parallel output of the random pattern differs\n");
+		return false;
+	}
+
+	// notes switch engines as they land, some of them to ones that draw noise
+	render_pattern(o, BP_DENSE, o.threads, true, parallel_out, false, true);
+	if (parallel_out != locked_out) {
+		fprintf(stderr, "parallel output of the locked pattern differs\n");
+		return false;
+	}
+	return true;
+}
+
+// dense pattern with long decays, so notes overlap and every track keeps all of its
+// voices busy. returns ns/sample and the average number of voices sounding.
+static double render_long_notes(const bench_options& o, int tracks, int voices,
+								double& sounding)
+{
+	const long samples = (long)(o.seconds * SAMPLERATE) / BLOCKSIZE * BLOCKSIZE;
+
+	auto dsp = std::make_shared<flechtbox_dsp>();
+	dsp->num_tracks = tracks;
+	dsp->voices_per_track = voices;
+	dsp_init(dsp);
+	dsp->params->master.running = true;
+
+	for (int i = 0; i < dsp->num_tracks; i++) {
+		auto& p = dsp->params->tracks[i];
+		p.sequence.data.fill(100);
+		p.decay = 1.f;
+		p.engine = (i * 5) % engine_names.size();
+	}
+	stmlib::Random::Seed(0x21);
+
+	std::vector<float> out(BLOCKSIZE * 2);
+	long active = 0;
+	long blocks = 0;
+	double ns = 0.0;
+	for (long i = 0; i < samples; i += BLOCKSIZE) {
+		auto start = std::chrono::steady_clock::now();
+		dsp_process_block(dsp, out.data(), BLOCKSIZE);
+		auto end = std::chrono::steady_clock::now();
+		ns += std::chrono::duration<double, std::nano>(end - start).count();
+
+		for (const auto& v : dsp->voices) active += v.active;
+		blocks++;
+	}
+
+	sounding = std::max(1.0, (double)active / blocks);
+	return ns / samples;
+}
+
+// voices/N_per_voice is the cost of one sounding voice, a core sustains about 100 / its
+// budget percent of them next to the mix and the reverb
+static void bench_voices(const bench_options& o, std::vector<bench_result>& results)
+{
+	for (int voices : {1, 2, 4, 8}) {
+		double sounding;
+		const double ns = render_long_notes(o, DEFAULT_TRACKS, voices, sounding);
+		const std::string name = "voices/" + std::to_string(voices);
+		results.push_back({name, ns});
+		results.push_back({name + "_per_voice", ns / sounding});
+	}
+}
+
+// the cost per track should stay flat with the track count, nothing in the audio path
+// is meant to grow faster than the tracks themselves
+static void bench_tracks(const bench_options& o, std::vector<bench_result>& results)
+{
+	for (int tracks : {4, 8, 16, 32}) {
+		double sounding;
+		const double ns = render_long_notes(o, tracks, 1, sounding);
+		const std::string name = "tracks/" + std::to_string(tracks);
+		results.push_back({name, ns});
+		results.push_back({name + "_per_track", ns / tracks});
+	}
+}
+
+// the slowest callback of the first bar after the transport starts against the slowest
+// of the second one. memory the callback touches for the first time faults in and
+// misses the tlb, the first bar should be no worse than the ones after it.
+static void bench_first_bar(std::vector<bench_result>& results)
+{
+	auto dsp = std::make_shared<flechtbox_dsp>();
+	dsp_init(dsp);
+	dsp->params->master.running = true;
+	for (int i = 0; i < dsp->num_tracks; i++) {
+		auto& p = dsp->params->tracks[i];
+		p.sequence.data.fill(100);
+		p.reverb_send_amt = 0.3f;
+		p.engine = (i * 5) % engine_names.size();
+	}
+
+	// 120 bpm
+	const long bar = (long)(2.0 * SAMPLERATE) / BLOCKSIZE * BLOCKSIZE;
+	std::vector<float> out(BLOCKSIZE * 2);
+	double worst[2] = {0.0, 0.0};
+	for (int b = 0; b < 2; b++) {
+		for (long i = 0; i < bar; i += BLOCKSIZE) {
+			auto start = std::chrono::steady_clock::now();
+			dsp_process_block(dsp, out.data(), BLOCKSIZE);
+			auto end = std::chrono::steady_clock::now();
+			const auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+			worst[b] = std::max(worst[b], ns / BLOCKSIZE);
+		}
+	}
+	results.push_back({"full/first_bar_worst_block", worst[0]});
+	results.push_back({"full/second_bar_worst_block", worst[1]});
+}
+
+// the silence after a bar of notes, when the filters and the effects decay towards
+// zero and, without flush-to-zero, through the denormal range. every voice renders
+// through the tail. ns/sample of the tail only.
+static double render_tail(const bench_options& o, reverb_backend reverb, bool flush)
+{
+	auto dsp = std::make_shared<flechtbox_dsp>();
+	dsp->skip_silent = false;
+	dsp->reverb_type = reverb;
+	dsp_init(dsp);
+	dsp->params->master.running = true;
+	dsp->params->reverb.time = 0.9f;
+	dsp->params->delay.feedback = 0.9f;
+	for (int i = 0; i < dsp->num_tracks; i++) {
+		auto& p = dsp->params->tracks[i];
+		p.sequence.data.fill(100);
+		p.reverb_send_amt = 0.5f;
+		p.delay_send_amt = 0.5f;
+		p.engine = (i * 5) % engine_names.size();
+	}
+
+	rt_flush_denormals(flush);
+	std::vector<float> out(BLOCKSIZE * 2);
+	const long bar = (long)(2.0 * SAMPLERATE);
+	for (long i = 0; i < bar; i += BLOCKSIZE)
+		dsp_process_block(dsp, out.data(), BLOCKSIZE);
+
+	dsp->params->master.running = false;
+	const long samples = (long)(o.seconds * SAMPLERATE) / BLOCKSIZE * BLOCKSIZE;
+	auto start = std::chrono::steady_clock::now();
+	for (long i = 0; i < samples; i += BLOCKSIZE)
+		dsp_process_block(dsp, out.data(), BLOCKSIZE);
+	auto end = std::chrono::steady_clock::now();
+	rt_flush_denormals(false);
+
+	return std::chrono::duration<double, std::nano>(end - start).count() / samples;
+}
+
+// what --rt saves on the tails
+static void bench_denormals(const bench_options& o, std::vector<bench_result>& results)
+{
+	results.push_back({"tail/12bit", render_tail(o, RB_CLOUDS_12BIT, false)});
+	results.push_back({"tail/12bit_ftz", render_tail(o, RB_CLOUDS_12BIT, true)});
+	results.push_back({"tail/float", render_tail(o, RB_FLOAT, false)});
+	results.push_back({"tail/float_ftz", render_tail(o, RB_FLOAT, true)});
+}
+
+// moves parameters and switches patterns from a second thread the way the ui does, as
+// fast as it can, while this thread renders. build with FLECHTBOX_TSAN to have ThreadSanitizer watch it.
+static bool stress_params(const bench_options& o)
+{
+	auto dsp = std::make_shared<flechtbox_dsp>();
+	dsp->num_workers = o.threads;
+	dsp_init(dsp);
+	dsp->params->master.running = true;
+
+	parameters edited;
+	parameters sent;
+	memcpy(&edited, dsp->params, sizeof(parameters));
+	memcpy(&sent, &edited, sizeof(parameters));
+
+	pattern_bank bank;
+	pattern_bank_init(bank, edited);
+
+	std::atomic<bool> stop {false};
+	std::atomic<bool> flushed {false};
+	long edits = 0;
+	long switches = 0;
+
+	std::thread ui([&] {
+		std::mt19937 rng(1);
+		auto uniform = [&](float lo, float hi) {
+			return std::uniform_real_distribution<float>(lo, hi)(rng);
+		};
+		auto pick = [&](int lo, int hi) {
+			return std::uniform_int_distribution<int>(lo, hi)(rng);
+		};
+
+		while (!stop) {
+			auto& m = edited.master;
+			auto& t = edited.tracks[pick(0, MAX_TRACKS - 1)];
+			const int s = pick(0, NUM_STEPS - 1);
+
+			switch (pick(0, 8)) {
+			case 0: m.tempo = uniform(20.f, 250.f); break;
+			case 1: t.harmonics = uniform(0.f, 1.f); break;
+			case 2: t.timbre = uniform(0.f, 1.f); break;
+			case 3: t.engine = pick(0, (int)engine_names.size() - 1); break;
+			case 4: t.sequence.data[s] = pick(0, 100); break;
+			case 5: t.sequence.length = pick(2, NUM_STEPS); break;
+			case 6: m.pitch_sequence.data[s] = pick(-12, 12); break;
+			case 7: t.muted = !t.muted; break;
+			case 8:
+				if (pick(0, 99) == 0 &&
+					pattern_queue(bank, pick(0, NUM_PATTERNS - 1), edited, sent, *dsp))
+					switches++;
+				break;
+			}
+			edits++;
+
+			param_sync(edited, sent, dsp->commands);
+
+			// and read back what the ui displays
+			(void)dsp->display.track_pos[0].load(std::memory_order_relaxed);
+		}
+
+		while (memcmp(&edited, &sent, sizeof(parameters)) != 0)
+			param_sync(edited, sent, dsp->commands);
+		flushed = true;
+	});
+
+	std::vector<float> out(BLOCKSIZE * 2);
+	long blocks = 0;
+	auto end = std::chrono::steady_clock::now() +
+			   std::chrono::duration<double>(o.seconds);
+
+	while (std::chrono::steady_clock::now() < end || !flushed || dsp->pattern_busy) {
+		if (std::chrono::steady_clock::now() >= end) stop = true;
+		dsp_process_block(dsp, out.data(), BLOCKSIZE);
+		blocks++;
+	}
+	ui.join();
+
+	// apply whatever is still queued
+	dsp_process_block(dsp, out.data(), BLOCKSIZE);
+
+	const bool match = memcmp(&edited, dsp->params, sizeof(parameters)) == 0;
+	printf("param stress: %ld edits and %ld pattern switches during %ld blocks, final "
+		   "parameters %s\n",
+		   edits, switches, blocks, match ? "match" : "DIFFER");
+	return match;
+}
+
+static double jitter_rms(const midi_jitter& j)
+{
+	const uint64_t n = j.count.load();
+	return n > 0 ? std::sqrt(j.sum_squares.load() / n) : 0.0;
+}
+
+// a master and a slave dsp on simulated time, linked by the queues the alsa thread
+// serves. the callback times jitter like a busy host's and the messages like those of
+// a usb midi interface. halfway through the master changes tempo. reports the tempo
+// the slave found, the jitter of the ticks it received and how far its metronome is
+// off them, each time after it had a few seconds to settle.
+static bool midi_loopback(const bench_options& o)
+{
+	const int frames = 256;
+	const double buffer_ns = frames * 1e9 / SAMPLERATE;
+	const double latency_ns = 2 * buffer_ns;
+
+	std::mt19937 rng(1);
+	std::normal_distribution<double> callback_jitter(0.0, 0.2e6);
+	std::normal_distribution<double> wire_jitter(0.0, 0.5e6);
+
+	auto make = [](midi_sync_mode mode, float tempo) {
+		auto dsp = std::make_shared<flechtbox_dsp>();
+		dsp->midi.mode = mode;
+		dsp_init(dsp);
+		dsp->params->master.tempo = tempo;
+		return dsp;
+	};
+	auto master = make(MIDI_SYNC_OUT, 120.f);
+	auto slave = make(MIDI_SYNC_IN, 90.f);
+	master->params->master.running = true;
+
+	// messages on their way, they can't overtake each other
+	std::deque<midi_event> wire;
+	uint64_t wire_time = 0;
+	std::vector<float> out(frames * 2);
+
+	// ten times the usual audio seconds, the loops need a while to settle
+	const long callbacks = (long)(o.seconds * 10 * SAMPLERATE / frames);
+	bool ok = true;
+	auto report = [&](float tempo) {
+		const float found = slave->midi.tempo.load();
+		const double input = jitter_rms(slave->midi.input_jitter) / 1e6;
+		const double offset = jitter_rms(slave->midi.clock_offset) / 1e6;
+		const double offset_max = slave->midi.clock_offset.max.load() / 1e6;
+		printf("midi clock at %.0f bpm: slave at %.2f bpm, input jitter rms %.3f ms, "
+			   "clock offset rms %.3f ms, max %.3f ms\n",
+			   tempo, found, input, offset, offset_max);
+
+		// the metronome should sit closer to the master than its ticks jitter around it
+		ok = ok && std::abs(found - tempo) < 0.1f && offset < 1.5 * input;
+	};
+
+	double t = 1e9;
+	for (long i = 0; i < callbacks; i++, t += buffer_ns) {
+		if (i == callbacks / 4 || i == callbacks * 3 / 4) {
+			midi_jitter_reset(slave->midi.input_jitter);
+			midi_jitter_reset(slave->midi.clock_offset);
+		}
+		if (i == callbacks / 2) {
+			report(120.f);
+			master->params->master.tempo = 140.f;
+		}
+
+		midi_sync_callback(master->midi, t + latency_ns + callback_jitter(rng), frames);
+		dsp_process_block(master, out.data(), frames);
+
+		midi_event e;
+		while (spsc_queue_pop(master->midi.out, e)) {
+			wire_time = std::max(wire_time, (uint64_t)(e.time + wire_jitter(rng)));
+			wire.push_back({wire_time, e.type});
+		}
+		while (!wire.empty() && wire.front().time <= t) {
+			spsc_queue_push(slave->midi.in, wire.front());
+			wire.pop_front();
+		}
+
+		midi_sync_callback(slave->midi, t + latency_ns + callback_jitter(rng), frames);
+		dsp_process_block(slave, out.data(), frames);
+	}
+	report(140.f);
+
+	return ok;
+}
+
+// saves random parameters, loads them back and compares, then checks that damaged and
+// truncated files are turned down. also times the load.
+static bool project_round_trip()
+{
+	const char* path = "flechtbox_bench.project";
+
+	std::mt19937 rng(1);
+	auto uniform = [&](float lo, float hi) {
+		return std::uniform_real_distribution<float>(lo, hi)(rng);
+	};
+	auto pick = [&](int lo, int hi) {
+		return std::uniform_int_distribution<int>(lo, hi)(rng);
+	};
+	auto randomize_seq = [&](param_seq& s, int lo, int hi) {
+		for (auto& v : s.data) v = pick(lo, hi);
+		s.length = pick(2, NUM_STEPS);
+		s.playback_dir = pick(PB_FORWARD, PB_RANDOM);
+		s.division = (clock_division)pick(CL_WHOLE, CL_THIRTYSECOND);
+	};
+
+	parameters saved;
+	parameters_init(saved);
+	saved.master.tempo = uniform(20.f, 250.f);
+	saved.master.seed = pick(0, 9999);
+	randomize_seq(saved.master.pitch_sequence, -12, 12);
+	randomize_seq(saved.master.octave_sequence, -36, 36);
+	randomize_seq(saved.master.velocity_sequence, 0, 100);
+	for (auto& t : saved.tracks) {
+		t.pitch = pick(0, 96);
+		t.engine = pick(0, (int)engine_names.size() - 1);
+		t.harmonics = uniform(0.f, 1.f);
+		t.timbre = uniform(0.f, 1.f);
+		t.morph = uniform(0.f, 1.f);
+		t.decay = uniform(0.f, 1.f);
+		t.reverb_send_amt = uniform(0.f, 1.f);
+		t.delay_send_amt = uniform(0.f, 1.f);
+		t.muted = pick(0, 1);
+		t.global_octave_enabled = pick(0, 1);
+		randomize_seq(t.sequence, 0, 100);
+		for (int s = 0; s < NUM_STEPS; s++) {
+			t.locks.mask[s] = pick(0, (1 << PL_NUM_TARGETS) - 1);
+			for (auto& v : t.locks.values[s]) v = uniform(0.f, 1.f);
+			t.locks.values[s][PL_ENGINE] = pick(0, (int)engine_names.size() - 1);
+		}
+	}
+	saved.reverb.time = uniform(0.f, 0.95f);
+	saved.delay.division = pick(0, CL_NUM_CLOCK_DIVISIONS - 1);
+	saved.delay.feedback = uniform(0.f, 0.95f);
+	saved.delay.ping_pong = pick(0, 1);
+
+	bool ok = true;
+	auto check = [&](bool condition, const char* what) {
+		if (!condition) fprintf(stderr, "project: %s\n", what);
+		ok = ok && condition;
+	};
+
+	const char* error = project_save(saved, path);
+	check(!error, "save failed");
+
+	parameters loaded;
+	parameters_init(loaded);
+	error = project_load(loaded, path);
+	check(!error, "load failed");
+	check(memcmp(&saved, &loaded, sizeof(parameters)) == 0, "loaded parameters differ");
+
+	const int loads = 10000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < loads; i++) project_load(loaded, path);
+	const double load_us = std::chrono::duration<double, std::micro>(
+							   std::chrono::steady_clock::now() - start)
+							   .count() /
+						   loads;
+
+	// flip one byte of the payload, then cut the file short
+	FILE* f = fopen(path, "r+b");
+	fseek(f, sizeof(project_header) + 8, SEEK_SET);
+	const int byte = fgetc(f);
+	fseek(f, sizeof(project_header) + 8, SEEK_SET);
+	fputc(byte ^ 0x40, f);
+	fclose(f);
+	check(project_load(loaded, path) != nullptr, "damaged file was loaded");
+	check(truncate(path, sizeof(project_header) + 16) == 0, "truncate failed");
+	check(project_load(loaded, path) != nullptr, "truncated file was loaded");
+	check(memcmp(&saved, &loaded, sizeof(parameters)) == 0,
+		  "failed load changed the parameters");
+	remove(path);
+
+	printf("project round trip: %s, %zu bytes, load takes %.2f us\n",
+		   ok ? "ok" : "FAILED", sizeof(project_header) + sizeof(parameters), load_us);
+	return ok;
+}
+
+static void print_results(const bench_options& o, const std::vector<bench_result>& results)
+{
+	const double budget_ns = 1e9 / SAMPLERATE;
+
+	switch (o.format) {
+	case BF_TABLE:
+		printf("%-32s %12s %10s\n", "case", "ns/sample", "% budget");
+		for (auto& r : results)
+			printf("%-32s %12.2f %9.2f%%\n", r.name.c_str(), r.ns_per_sample,
+				   r.ns_per_sample / budget_ns * 100.0);
+		break;
+	case BF_CSV:
+		printf("case,ns_per_sample,budget_percent\n");
+		for (auto& r : results)
+			printf("%s,%.3f,%.3f\n", r.name.c_str(), r.ns_per_sample,
+				   r.ns_per_sample / budget_ns * 100.0);
+		break;
+	case BF_JSON:
+		printf("{\n  \"samplerate\": %.0f,\n  \"results\": [\n", SAMPLERATE);
+		for (size_t i = 0; i < results.size(); i++) {
+			auto& r = results[i];
+			printf("    {\"case\": \"%s\", \"ns_per_sample\": %.3f, \"budget_percent\": "
+				   "%.3f}%s\n",
+				   r.name.c_str(), r.ns_per_sample, r.ns_per_sample / budget_ns * 100.0,
+				   i + 1 < results.size() ? "," : "");
+		}
+		printf("  ]\n}\n");
+		break;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	rt_check_init();
+
+	bench_options o;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--csv")) o.format = BF_CSV;
+		else if (!strcmp(argv[i], "--json")) o.format = BF_JSON;
+		else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) o.seconds = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--threads") && i + 1 < argc) o.threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--stress-params")) o.stress_params = true;
+		else if (!strcmp(argv[i], "--project")) o.project = true;
+		else if (!strcmp(argv[i], "--midi")) o.midi = true;
+		else {
+			fprintf(stderr,
+					"usage: %s [--csv|--json] [--seconds S] [--threads N] "
+					"[--stress-params] [--project] [--midi]\n",
+					argv[0]);
+			return 1;
+		}
+	}
+
+	if (o.stress_params) return (stress_params(o) && rt_check_violations() == 0) ? 0 : 1;
+	if (o.project) return project_round_trip() ? 0 : 1;
+	if (o.midi) return midi_loopback(o) ? 0 : 1;
+
+	std::vector<bench_result> results;
+	bench_engines(o, results);
+	bench_stages(o, results);
+	const bool mix_identical = bench_mix(o, results);
+	const bool identical = bench_full(o, results);
+	bench_voices(o, results);
+	bench_tracks(o, results);
+	bench_first_bar(results);
+	bench_denormals(o, results);
+	print_results(o, results);
+
+	return (mix_identical && identical && rt_check_violations() == 0) ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <new>
+
+// one mapping for all the memory the voices and the effects render into. it is
+// allocated once in dsp_init, backed by huge pages where the system has them, locked
+// and touched up front, so the callback neither faults pages in nor walks the page
+// tables of scattered heap blocks. allocations are handed out in order, each on its
+// own cache lines, and all go at once with the arena.
+
+const size_t ARENA_ALIGN = 64;
+
+struct arena {
+	char* base = nullptr;
+	size_t size = 0; // of the mapping
+	size_t used = 0;
+
+	bool huge_pages = false; // explicit huge pages, otherwise transparent ones if any
+	bool locked = false;
+
+	~arena();
+};
+
+// size rounded up to whole cache lines, what an allocation takes of the arena
+inline size_t arena_round(size_t size)
+{
+	return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+// maps at least `size` bytes of zeroed memory, false if that fails
+bool arena_init(arena& a, size_t size);
+
+// null when the arena is full
+void* arena_alloc(arena& a, size_t size);
+
+// default constructed objects, null when the arena is full. their destructors are
+// not run by arena_free.
+template <typename T>
+T* arena_new(arena& a, size_t count = 1)
+{
+	static_assert(alignof(T) <= ARENA_ALIGN, "over-aligned type");
+	void* p = arena_alloc(a, sizeof(T) * count);
+	if (!p) return nullptr;
+	T* objects = static_cast<T*>(p);
+	for (size_t i = 0; i < count; i++) new (&objects[i]) T();
+	return objects;
+}
+
+void arena_free(arena& a);
+
+// size and backing in plain text
+void arena_print(const arena& a, FILE* f);
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <future>
 #include <memory>
 #include <portaudio.h>
 
 #include "dsp.hpp"
+#include "rt_thread.hpp"
 
 // struct flechtbox_dsp {
 //   metronome clock;
@@ -20,4 +22,7 @@ int portaudio_callback(const void *input, void *outputBuffer,
                        const PaStreamCallbackTimeInfo *timeInfo,
                        PaStreamCallbackFlags statusFlags, void *userData);
 
-void audio_run(std::shared_ptr<flechtbox_dsp> dsp);
+// sets up the calling thread with `rt` before the host starts, so its callback thread
+// inherits that, and hands back how that went through `setup`
+void audio_run(std::shared_ptr<flechtbox_dsp> dsp, rt_thread_options rt,
+               std::promise<rt_thread_result> setup);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <cmath>
 #include <cstdio>
 
 enum clock_division {
@@ -20,8 +21,10 @@ struct metronome {
 	bool quarter_gate = false;
 	bool thirtysecond_gate = false;
 
-	std::array<float, CL_NUM_CLOCK_DIVISIONS> phases = {0.0}; // For each clock
+	std::array<double, CL_NUM_CLOCK_DIVISIONS> phases = {0.0}; // For each clock
 	std::array<bool, CL_NUM_CLOCK_DIVISIONS> cur_clock_states = {false};
+	// sample within the last block at which each division ticked
+	std::array<int, CL_NUM_CLOCK_DIVISIONS> cur_clock_offsets = {0};
 };
 
 // Division multipliers (relative to quarter note)
@@ -34,33 +37,37 @@ static constexpr float division_multipliers[CL_NUM_CLOCK_DIVISIONS] = {
 	8.0f		 // thirtysecond
 };
 
+// advances the clock by one block. instead of stepping every sample, the sample at
+// which a division wraps is computed from its phase, so each division costs a divide
+// per block. blocks must be shorter than a thirtysecond note, so that no division
+// ticks twice in one block.
 inline std::array<bool, CL_NUM_CLOCK_DIVISIONS>& clock_process_block(metronome& c,
 																	 int frames)
 {
-	if (!c.running) return c.cur_clock_states;
+	if (!c.running) {
+		c.cur_clock_states.fill(false);
+		return c.cur_clock_states;
+	}
+
+	for (int div = 0; div < CL_NUM_CLOCK_DIVISIONS; ++div) {
+		// Calculate frequency (beats per second)
+		double bps = (c.tempo / 60.0) * division_multipliers[div];
+		double phase_inc = bps / c.samplerate;
 
-	// clear clock states
-	for (int div = 0; div < CL_NUM_CLOCK_DIVISIONS; ++div)
-		c.cur_clock_states[div] = false;
+		// the phase reaches 1.0 after this many samples, the tick lands on the last one
+		double to_wrap = std::ceil((1.0 - c.phases[div]) / phase_inc);
+		bool tick = to_wrap <= frames;
 
-	for (int i = 0; i < frames; ++i) {
-		for (int div = 0; div < CL_NUM_CLOCK_DIVISIONS; ++div) {
-			// Calculate frequency (beats per second)
-			double bps = (c.tempo / 60.0) * division_multipliers[div];
-			double phase_inc = bps / c.samplerate;
-			c.phases[div] += phase_inc;
-			if (c.phases[div] >= 1.0) {
-				c.phases[div] -= 1.0;
-				c.cur_clock_states[div] = true;
-			}
-		}
+		c.cur_clock_states[div] = tick;
+		c.cur_clock_offsets[div] = (tick && to_wrap > 1.0) ? (int)to_wrap - 1 : 0;
 
-		// gates for visualization
-		double quarter_phase = c.phases[CL_QUARTER];
-		double thirty_second_phase = c.phases[CL_THIRTYSECOND];
-		c.quarter_gate = (quarter_phase < 0.5);
-		c.thirtysecond_gate = (thirty_second_phase < 0.5);
+		c.phases[div] += phase_inc * frames;
+		if (tick) c.phases[div] -= 1.0;
 	}
 
+	// gates for visualization
+	c.quarter_gate = (c.phases[CL_QUARTER] < 0.5);
+	c.thirtysecond_gate = (c.phases[CL_THIRTYSECOND] < 0.5);
+
 	return c.cur_clock_states;
 }
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "parameters.hpp"
+#include "spsc.hpp"
+
+// a change to one 32 bit word of `parameters`, addressed by its byte offset. every
+// field is at most 32 bits wide, so a word always holds complete values.
+struct param_cmd {
+	uint32_t offset;
+	uint32_t value;
+};
+
+static_assert(sizeof(parameters) % sizeof(uint32_t) == 0,
+			  "parameters must be made of whole 32 bit words");
+
+typedef spsc_queue<param_cmd, 4096> param_queue;
+
+// not a parameter: from here on edits belong to the pattern the ui queued, which the
+// audio thread switches to on the next bar. see patterns.hpp.
+const uint32_t PARAM_CMD_PATTERN = UINT32_MAX;
+
+// words that belong to no pattern. they stay the same across pattern switches. the
+// effects settings come last in `parameters`, all of them are global.
+inline bool param_offset_is_global(uint32_t offset)
+{
+	return offset == offsetof(parameters, master.tempo) ||
+		   offset == offsetof(parameters, master.running) ||
+		   offset == offsetof(parameters, master.scale) ||
+		   offset >= offsetof(parameters, reverb);
+}
+
+inline void param_cmd_apply(parameters& p, const param_cmd& c)
+{
+	if (c.offset + sizeof(uint32_t) > sizeof(parameters)) return;
+	memcpy(reinterpret_cast<char*>(&p) + c.offset, &c.value, sizeof(uint32_t));
+}
+
+// ui side. pushes every word where `edited` differs from `sent` and updates `sent`
+// accordingly. words that don't fit into a full queue stay different and go out on the
+// next call, so nothing is lost while the audio thread lags behind.
+inline void param_sync(const parameters& edited, parameters& sent, param_queue& q)
+{
+	const char* e = reinterpret_cast<const char*>(&edited);
+	char* s = reinterpret_cast<char*>(&sent);
+
+	for (uint32_t offset = 0; offset < sizeof(parameters); offset += sizeof(uint32_t)) {
+		if (memcmp(e + offset, s + offset, sizeof(uint32_t)) == 0) continue;
+
+		param_cmd c;
+		c.offset = offset;
+		memcpy(&c.value, e + offset, sizeof(uint32_t));
+		if (!spsc_queue_push(q, c)) return;
+
+		memcpy(s + offset, &c.value, sizeof(uint32_t));
+	}
+}
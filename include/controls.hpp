@@ -5,6 +5,7 @@
 #include <ftxui/dom/direction.hpp>
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/screen/color.hpp>
+#include <cstdint>
 #include <functional>
 #include <iomanip>
 #include <memory>
@@ -144,14 +145,18 @@ inline Component IntegerControl(int* value_ptr, std::string label = "", int step
 							  format);
 }
 
+// lock_mask, if given, marks the step when it has parameter locks
 inline Component StepSlider(int* value_ptr, int step, unsigned int* step_active,
 							int* sequence_length, int increment = 25, int min_value = 0,
-							int max_value = 100)
+							int max_value = 100, const uint32_t* lock_mask = nullptr)
 {
 	auto renderer = Renderer(
-		[value_ptr, step_active, step, max_value, sequence_length](bool focused) {
+		[value_ptr, step_active, step, max_value, sequence_length,
+		 lock_mask](bool focused) {
 			auto g1 = gaugeUp(*value_ptr / static_cast<float>(max_value));
-			auto t = text(std::to_string(step + 1));
+			auto label = std::to_string(step + 1);
+			if (lock_mask && *lock_mask) label += "*";
+			auto t = text(label);
 			auto gauge_box = hbox(g1) | border;
 
 			if (focused) {
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "arena.hpp"
+
+// stereo delay synced to the clock, the send effect next to the reverb. one power of
+// two ring of floats holds both channels interleaved, lane 0 left and lane 1 right, and
+// every sample runs both lanes in one float vector. the feedback passes a low pass and
+// a fixed low cut, and with ping_pong it crosses over to the other channel, so the
+// repeats alternate between left and right.
+
+struct float_delay {
+	float* data = nullptr;
+	uint32_t mask = 0;
+	// advances by one every sample
+	uint32_t write_ptr = 0;
+
+	float feedback = 0.4f;
+	float lp = 0.5f;
+	float level = 0.8f;
+	bool ping_pong = true;
+
+	// in samples. a new time isn't jumped to, `time` glides towards `target` over some
+	// 50 ms, which bends the pitch of the repeats for a moment like a tape delay would
+	// instead of clicking.
+	float time = 0.f;
+	float target = 0.f;
+	float glide = 0.f;
+
+	float samplerate = 48000.f;
+	float hp_coefficient = 0.f;
+	float lp_state[2] = {0.f, 0.f};
+	float hp_state[2] = {0.f, 0.f};
+};
+
+// what float_delay_init takes of the arena
+size_t float_delay_memory(float samplerate);
+
+// takes the ring from the arena, false if the arena is too small
+bool float_delay_init(float_delay& d, float samplerate, arena& memory);
+
+// glides to a delay of `seconds`, halved until it fits into the ring
+void float_delay_set_time(float_delay& d, float seconds);
+
+// feeds the mono send `in` to the delay and adds its output, scaled by `level`, to the
+// two channels of `out`
+void float_delay_process(float_delay& d, const float* in, float** out, size_t block_size);
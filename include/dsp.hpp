@@ -4,86 +4,264 @@
 #include <atomic>
 #include <audio_buffer.h>
 #include <memory>
+#include <vector>
 #include <plaits/dsp/dsp.h>
 #include <plaits/dsp/voice.h>
 
+#include "arena.hpp"
 #include "clock.hpp"
+#include "commands.hpp"
+#include "delay.hpp"
+#include "mix.hpp"
+#include "midi_sync.hpp"
 #include "parameters.hpp"
+#include "profiler.hpp"
+#include "redraw.hpp"
 #include "reverb.hpp"
+#include "reverb_float.hpp"
+#include "resampler.hpp"
+#include "rng.hpp"
+#include "stats.hpp"
 #include "sequencer.hpp"
+#include "workers.hpp"
 
+// default device rate, and the rate the synth runs at when resampling
 const double SAMPLERATE = 48000;
 const int BLOCKSIZE = 512;
 const int PLAITS_BLOCKSIZE = 16;
 
-const int NUM_TRACKS = 9;
-const int NUM_STEPS = 10;
+// the plaits voice delays its trigger input by kTriggerDelay renders. the clock runs
+// that many sub-blocks ahead of the audio, so a trigger can be written early enough to
+// come out of the delay on the exact sample of its tick.
+const int CLOCK_LOOKAHEAD = plaits::kTriggerDelay;
 
-struct flechtbox_track {
-	int pitch = 48;
+enum reverb_backend {
+	RB_CLOUDS_12BIT, // the clouds fx engine on a 12 bit buffer, 32 kB
+	RB_FLOAT		 // float delay lines, about 100 kB but cheaper to run
+};
+
+// a voice whose output stayed below SILENCE_THRESHOLD for SILENCE_HANGOVER sub-blocks
+// is not rendered or mixed anymore until its next note
+const int SILENCE_THRESHOLD = 8;  // of the 16 bit plaits output, about -72 dB
+const int SILENCE_HANGOVER = 128; // sub-blocks, about 43 ms
+
+// the most voices a track can have, see flechtbox_dsp::voices_per_track
+const int MAX_VOICES = 16;
+
+// the parameter locks of the step a note was triggered on
+struct step_lock {
+	uint32_t mask = 0;
+	std::array<float, PL_NUM_TARGETS> values {};
+};
 
-	float harmonics = 0.5f;
-	float harmonics_rand_amt = 0.f;
+// a sequenced step waiting for its trigger to come out of the delay
+struct track_note {
+	int countdown = -1; // sub-blocks until the note lands, -1 if none is pending
+	int offset = 0;		// sample within the landing sub-block
+	float note = 0.f;
+	float velocity = 1.f;
 	float harmonics_rand_val = 0.f;
-	float timbre = 0.5f;
-	float timbre_rand_amt = 0.f;
 	float timbre_rand_val = 0.f;
-	float morph = 0.5f;
-	float morph_rand_amt = 0.f;
 	float morph_rand_val = 0.f;
+	step_lock lock;
+	int voice = 0; // of the track, picked when the trigger is written
+};
 
-	bool global_pitch_enabled = true;
-	bool global_velocity_enabled = true;
-	bool global_octave_enabled = true;
-
-	float reverb_send_amt = 0.0f;
+// one plaits voice of a track and the note it plays
+struct track_voice {
+	float harmonics_rand_val = 0.f;
+	float timbre_rand_val = 0.f;
+	float morph_rand_val = 0.f;
 
 	float current_velocity = 1.f;
 
+	// locks of the last note that landed, they hold until the next one
+	step_lock lock;
+
+	// when a note lands mid sub-block, the samples before `split` are rendered with the
+	// previous patch and velocity, the rest with `split_patch` and current_velocity
+	int split = 0;
+	float previous_velocity = 1.f;
+	plaits::Patch split_patch;
+
 	plaits::Patch plaits_patch;
 	plaits::Modulations plaits_mods;
-	plaits::Voice* voice;
-	plaits::Voice::Frame* frames;
+	plaits::Voice* voice = nullptr;
+	plaits::Voice::Frame* frames = nullptr;
+
+	char* shared_buffer = nullptr;
+
+	// whether the voice is rendered in the current sub-block, see SILENCE_HANGOVER.
+	// a voice that never played counts as silent.
+	bool active = true;
+	int silent_blocks = SILENCE_HANGOVER;
 
-	char* shared_buffer;
-	bool enabled = true;
-	bool muted = false;
+	// for picking the voice a new note takes: the peak of the last render and the
+	// sub-block the note landed in
+	int peak = 0;
+	uint64_t started = 0;
 
-	float volume = 1.f;
+	// time spent rendering the current sub-block, zero if it wasn't rendered
+	uint64_t render_ticks = 0;
+};
+
+// runtime state of a track, its settings live in param_track
+struct flechtbox_track {
+	// num_voices voices out of flechtbox_dsp::voices
+	track_voice* voices = nullptr;
+	int num_voices = 0;
 
+	track_note pending;
+
+	// step probabilities and parameter randomization
+	rng32 rng;
 	track_seq sequencer;
 };
 
-void flechtbox_track_init(flechtbox_track& p);
+// state the audio thread publishes for the ui to display. `redraw` is raised when
+// any of it changes, and for the meters a few times per second.
+struct dsp_display {
+	std::atomic<bool> quarter_gate {false};
+
+	std::atomic<unsigned int> pitch_pos {0};
+	std::atomic<unsigned int> octave_pos {0};
+	std::atomic<unsigned int> velocity_pos {0};
+	std::array<std::atomic<unsigned int>, MAX_TRACKS> track_pos {};
+
+	redraw_signal redraw;
+
+	// audio thread only
+	uint64_t meters_frame = 0; // frames_rendered when the meters were last raised
+	bool pattern_pending = false;
+};
+
+// takes the plaits voice, its frames and its buffer from `memory`, false if it is full
+bool track_voice_init(track_voice& v, arena& memory);
+
+// what track_voice_init takes of the arena
+size_t track_voice_memory();
 
 struct flechtbox_dsp {
 	metronome clock;
-	parameters params;
+
+	// only touched by the audio thread once it runs. the ui sends its edits through
+	// `commands`, which are applied at the start of every sub-block.
+	// the audio thread reads the parameters through `params`, which points into one of
+	// two buffers. a pattern switch fills the other one and the audio thread swaps the
+	// pointer on the next bar, see patterns.hpp.
+	std::array<parameters, 2> param_buffers;
+	parameters* params = &param_buffers[0];
+	param_queue commands;
+
+	// set by the ui while it fills the spare buffer, until the audio thread switched
+	std::atomic<bool> pattern_busy {false};
+	// a switch arrived through `commands` and waits for the bar, audio thread only
+	bool pattern_pending = false;
+
+	dsp_display display;
+	audio_stats stats;
+	profiler profile;
+
+	// midi clock in or out, the mode is set before dsp_init
+	midi_sync midi;
+	// synth frames rendered so far
+	uint64_t frames_rendered = 0;
+
+	// the random generators start over from params->master.seed when the metronome
+	// starts or the seed changes
+	int seed = -1;
+	bool was_running = false;
+
 	std::atomic<bool> should_quit {false};
 
 	track_seq pitch_sequence;
 	track_seq velocity_sequence;
 	track_seq octave_sequence;
 
-	std::array<flechtbox_track, NUM_TRACKS> tracks {};
+	// tracks played, 1 to MAX_TRACKS, set before dsp_init. the tracks, their voices
+	// and the job lists are sized for it there.
+	int num_tracks = DEFAULT_TRACKS;
+	std::vector<flechtbox_track> tracks;
+
+	// stop rendering voices that went silent, off renders every voice all the time
+	bool skip_silent = true;
 
+	// which reverb runs, set before dsp_init
+	reverb_backend reverb_type = RB_CLOUDS_12BIT;
 	clouds_reverb reverb;
+	float_reverb reverb_float;
+	// synced to the clock, always float
+	float_delay delay;
 
 	trnr::audio_buffer<float> reverb_buffer;
+	trnr::audio_buffer<float> delay_buffer; // the mono send
 	trnr::audio_buffer<float> mix_buffer;
+
+	// threads rendering voices besides the audio thread, 0 renders serially.
+	// set before dsp_init.
+	int num_workers = 0;
+	std::vector<int> worker_cpus;
+
+	worker_pool workers;
+	// --rt: the audio callback and the workers run with flush-to-zero, and the workers
+	// with real-time priority. set before dsp_init.
+	bool realtime = false;
+	// indices into `voices`, rendered by the workers or serially on the audio thread
+	std::vector<int> worker_jobs;
+	std::vector<int> serial_jobs;
+	// what dsp_mix_tracks hands to the mix bus, one per voice
+	std::vector<mix_voice> mix_list;
+
+	// plaits voices per track, 1 to MAX_VOICES, set before dsp_init. a new note takes
+	// a silent voice or else steals the quietest one, the oldest of equally quiet ones.
+	// all of them are allocated up front, track after track.
+	int voices_per_track = 1;
+	std::vector<track_voice> voices;
+
+	// the plaits voices, their frames and buffers and the effects memory, see arena.hpp
+	arena memory;
+
+	~flechtbox_dsp();
+
+	// rate of the audio device, set before dsp_init. the synth runs at this rate as
+	// well, or with `resample` at SAMPLERATE, resampled to the device rate.
+	double samplerate = SAMPLERATE;
+	bool resample = false;
+	resampler output_resampler;
+
+	// frames per buffer requested from the audio device, set before audio_run.
+	// 0 leaves the choice to the host, any size works.
+	int buffer_size = BLOCKSIZE;
+
+	// the rest of a sub-block that didn't fit into the last host buffer, interleaved.
+	// fifo_pos frames of it have been handed out already.
+	std::array<float, PLAITS_BLOCKSIZE * 2> fifo {};
+	int fifo_pos = PLAITS_BLOCKSIZE;
 };
 
-void dsp_init(std::shared_ptr<flechtbox_dsp> dsp);
+// false if the memory for the voices and the effects can't be mapped
+bool dsp_init(std::shared_ptr<flechtbox_dsp> dsp);
 
-void dsp_process_block(std::shared_ptr<flechtbox_dsp> dsp, float* out, int frames);
+// the rate plaits, the clock and the reverb run at
+double dsp_synth_rate(const flechtbox_dsp& dsp);
 
-inline float soft_clip(float x)
+// the parameter buffer `params` doesn't point to
+inline parameters* dsp_spare_params(flechtbox_dsp& dsp)
 {
-	if (x < -3.f) {
-		return -1.f;
-	} else if (x > 3.f) {
-		return 1.f;
-	} else {
-		return x * (27.f + x * x) / (27.f + 9.f * x * x);
-	}
+	return dsp.params == &dsp.param_buffers[0] ? &dsp.param_buffers[1]
+											   : &dsp.param_buffers[0];
 }
+
+// renders `frames` frames of interleaved stereo, any number of them
+void dsp_process_block(std::shared_ptr<flechtbox_dsp> dsp, float* out, int frames);
+
+// stages of a single PLAITS_BLOCKSIZE sub-block, in the order dsp_process_block runs
+// them. exposed separately so they can be timed by the benchmark.
+void dsp_apply_commands(flechtbox_dsp& dsp);
+void dsp_process_tracks(flechtbox_dsp& dsp, const metronome& clock);
+void dsp_mix_tracks(flechtbox_dsp& dsp);
+void dsp_process_effects(flechtbox_dsp& dsp);
+void dsp_write_output(flechtbox_dsp& dsp, float* out);
+
+// copies playheads and clock gates to dsp_display, once per dsp_process_block
+void dsp_publish_display(flechtbox_dsp& dsp);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// display names of the plaits engines, indexed by plaits::Patch::engine
+const std::vector<std::string> engine_names = {
+	"classic waveshapes",
+	"phase distortion",
+	"fm 1",
+	"fm 2",
+	"fm 3",
+	"wave terrain",
+	"string machine",
+	"arpeggiator",
+	"virtual analog",
+	"asymmetric triangle",
+	"2 sine waves",
+	"formants",
+	"additive sines",
+	"wavetable",
+	"chords",
+	"speech",
+	"sawtooth swarm",
+	"filtered noise",
+	"dust noise",
+	"rings a",
+	"rings b",
+	"kick",
+	"snare",
+	"hihat",
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "midi_sync.hpp"
+
+// alsa sequencer client "flechtbox" with one port, "clock". as slave it receives the
+// clock, start, stop and continue messages sent to the port and passes them on with the
+// time they arrived. as master it schedules the messages the audio thread sends out on
+// a real-time queue, so they leave on time whatever the thread is doing. the port is
+// connected with aconnect or any patchbay.
+
+// opens the client and starts the midi thread for m.mode, returns false if the
+// sequencer isn't available
+bool midi_alsa_start(midi_sync& m);
+
+void midi_alsa_stop();
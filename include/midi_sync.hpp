@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#include "clock.hpp"
+#include "spsc.hpp"
+
+// midi clock sync, as slave or as master. the midi thread (midi_alsa.hpp) timestamps
+// the realtime messages it receives and passes them to the audio thread through `in`.
+// as master the audio thread works out when each of its ticks reaches the dac and
+// passes them out through `out` for the midi thread to schedule. all times are
+// stats_now() nanoseconds.
+//
+// two delay-locked loops smooth the timing, after fons adriaensen's "using a dll to
+// filter time": one maps device frames to the time they reach the dac from the jittery
+// callback times, the other follows the 24 ppq clock of the master. the metronome is
+// steered onto the master's position by bending its tempo a little, so it never jumps
+// and never skips a step.
+
+const int MIDI_PPQ = 24;
+
+enum midi_sync_mode { MIDI_SYNC_OFF, MIDI_SYNC_IN, MIDI_SYNC_OUT };
+
+// the realtime messages that are passed on, with their status bytes
+enum midi_realtime : uint8_t {
+	MIDI_CLOCK = 0xf8,
+	MIDI_START = 0xfa,
+	MIDI_CONTINUE = 0xfb,
+	MIDI_STOP = 0xfc,
+};
+
+struct midi_event {
+	uint64_t time;
+	midi_realtime type;
+};
+
+// second order dll. `time` is the filtered time of the last event and `period` the
+// filtered time from one event to the next, both in nanoseconds.
+struct time_dll {
+	double time = 0.0;
+	double period = 0.0;
+	double bandwidth = 1.0; // of the loop, in Hz
+};
+
+void dll_init(time_dll& d, double time, double period, double bandwidth);
+
+// feeds the time of the event `n` periods after the last one. returns how far it was
+// off the prediction.
+double dll_update(time_dll& d, double time, double n);
+
+// errors in nanoseconds, written by the audio thread only
+struct midi_jitter {
+	std::atomic<uint64_t> count {0};
+	std::atomic<double> sum_squares {0.0};
+	std::atomic<double> max {0.0};
+};
+
+void midi_jitter_reset(midi_jitter& j);
+
+struct midi_sync {
+	// set before dsp_init
+	midi_sync_mode mode = MIDI_SYNC_OFF;
+
+	spsc_queue<midi_event, 256> in;	 // midi thread to audio thread
+	spsc_queue<midi_event, 256> out; // audio thread to midi thread
+
+	// the rest is audio thread only
+
+	// dac time of device frame `audio_frame`, from the callback times
+	time_dll audio;
+	uint64_t audio_frame = 0;
+	int last_frames = 0; // of the previous callback, 0 before the first
+	double frame_ns = 0.0;
+	double device_per_synth = 1.0; // device frames per synth frame
+	double synth_rate = 0.0;
+
+	// as slave: time of the master's clock tick number `tick`, counted from its start
+	time_dll ticks;
+	bool ticks_locked = false;
+	uint64_t last_tick = 0; // raw time of the last tick, 0 before the first
+	double tick = 0.0;
+	bool waiting = false;		// a start or continue waits for the next tick
+	bool rewind = false;		// ... and it was a start
+	bool running = false;
+
+	// quarter notes the metronome advanced since the transport started
+	double beats = 0.0;
+
+	// tempo of the master, or our own as master. 0 until one is known.
+	std::atomic<float> tempo {0.f};
+	// incoming ticks against the dll, and the metronome against the incoming ticks
+	midi_jitter input_jitter;
+	midi_jitter clock_offset;
+	std::atomic<uint64_t> sent {0};
+	// messages the midi thread couldn't queue
+	std::atomic<uint64_t> dropped {0};
+};
+
+void midi_sync_init(midi_sync& m, double samplerate, double synth_rate);
+
+// at the start of every audio callback, with the time the buffer reaches the dac
+void midi_sync_callback(midi_sync& m, uint64_t dac_time, int frames);
+
+// before the metronome advances by `frames` synth frames, clock_frame being the first
+// of them. follows the master's tempo, position and transport, or sends our clock.
+// returns true when the sequences have to start over from their first step.
+bool midi_sync_sub_block(midi_sync& m, metronome& clock, uint64_t clock_frame,
+						 int frames);
+
+// tempo and jitter in plain text
+void midi_sync_print(const midi_sync& m, FILE* f);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <plaits/dsp/voice.h>
+
+// mix bus of one sub-block. the interleaved 16 bit voice frames are converted to float
+// lanes, scaled and summed into a mono dry bus and mono reverb and delay sends, all in
+// one pass and several samples at a time. scalar, sse2 and avx2 versions exist,
+// mix_init picks the best one the cpu supports.
+
+enum mix_impl {
+	MIX_SCALAR,
+	MIX_SSE2,
+	MIX_AVX2,
+	MIX_NUM_IMPLS
+};
+
+// what the mix needs to know about a track for the current sub-block
+struct mix_voice {
+	const plaits::Voice::Frame* frames;
+	// velocity * volume before and from sample `split` on, where a note lands
+	float gain_before;
+	float gain_after;
+	int split;
+	float reverb_send;
+	float delay_send;
+};
+
+// selects the fastest implementation, call once before mixing
+void mix_init();
+
+// forces an implementation, returns false if the cpu doesn't support it
+bool mix_select(mix_impl impl);
+mix_impl mix_selected();
+const char* mix_impl_name(mix_impl impl);
+
+// sums `num_voices` voices into `dry` and the sends, `frames` must be a multiple of 8
+void mix_voices(const mix_voice* voices, int num_voices, float* dry, float* reverb,
+				float* delay, int frames);
+
+// adds the wet signal to the dry one, soft clips and interleaves into `out`
+void mix_write_output(const float* dry_l, const float* dry_r, const float* wet_l,
+					  const float* wet_r, float* out, int frames);
@@ -1,29 +1,124 @@
+#pragma once
+
 #include <array>
+#include <cstdint>
+
+#include "clock.hpp"
 
-struct param_step {
-  bool enabled = false;
-  int probability = 100;
+// parameters are kept for MAX_TRACKS tracks, so projects and patterns have one layout
+// however many tracks run. flechtbox_dsp::num_tracks of them are played.
+const int MAX_TRACKS = 32;
+const int DEFAULT_TRACKS = 9;
+const int NUM_STEPS = 10;
+
+enum playback_directions {
+	PB_FORWARD,
+	PB_BACKWARD,
+	PB_PENDULUM,
+	PB_RANDOM
 };
 
-struct param_track {
-  std::array<param_step, 10> steps;
-  unsigned int length;
+enum param_scale {
+	T_MAJOR,
+	T_MINOR
+};
+
+// everything in here is plain data that the user edits. the audio thread owns the
+// copy in flechtbox_dsp, the ui edits its own copy and sends the changes over
+// flechtbox_dsp::commands (see commands.hpp).
+
+// what a step can lock, see param_locks
+enum param_lock_target {
+	PL_HARMONICS,
+	PL_TIMBRE,
+	PL_MORPH,
+	PL_DECAY,
+	PL_ENGINE, // the engine index as a float
+	PL_NUM_TARGETS
 };
 
-enum param_scale { T_MAJOR, T_MINOR };
+// per-step parameter locks of a track. bit k of mask[s] locks target k to
+// values[s][k] for notes triggered on step s.
+struct param_locks {
+	std::array<uint32_t, NUM_STEPS> mask {};
+	std::array<std::array<float, PL_NUM_TARGETS>, NUM_STEPS> values {};
+};
+
+struct param_seq {
+	std::array<int, NUM_STEPS> data {};
+	int length = 10;
+	int playback_dir = PB_FORWARD;
+	clock_division division = CL_SIXTEENTH;
+};
+
+struct param_track {
+	int pitch = 48;
+
+	float harmonics = 0.5f;
+	float harmonics_rand_amt = 0.f;
+	float timbre = 0.5f;
+	float timbre_rand_amt = 0.f;
+	float morph = 0.5f;
+	float morph_rand_amt = 0.f;
+
+	int engine = 8;
+	float decay = 0.5f;
+	float lpg_colour = 0.5f;
+
+	bool global_pitch_enabled = true;
+	bool global_velocity_enabled = true;
+	bool global_octave_enabled = true;
+	bool muted = false;
+
+	float reverb_send_amt = 0.0f;
+	float delay_send_amt = 0.0f;
+	float volume = 1.f;
+
+	param_seq sequence;
+	param_locks locks;
+};
 
 struct param_master {
-  std::array<int, 10> pitch_steps;
-  unsigned int pitch_length;
-  std::array<int, 10> velocity_steps;
-  unsigned int velocity_length;
-  std::array<int, 10> octave_steps;
-  unsigned int octave_length;
+	float tempo = 120.f;
+	bool running = false;
+
+	param_seq pitch_sequence;
+	param_seq octave_sequence;
+	param_seq velocity_sequence;
 
-  param_scale scale = T_MINOR;
+	param_scale scale = T_MINOR;
+
+	// every random draw of the sequencer starts over from this seed when the transport
+	// starts, so a pattern plays and renders the same every time
+	int seed = 1;
+};
+
+// shared by both reverb backends
+struct param_reverb {
+	float input_gain = 0.2f;
+	float time = 0.25f; // feedback of the loop, below 1
+	float diffusion = 0.625f;
+	float lp = 0.7f;
+};
+
+// the delay repeats in time with the clock, every `division` (a clock_division)
+struct param_delay {
+	int division = CL_EIGHTH;
+	float feedback = 0.4f; // below 1
+	float lp = 0.5f;	   // low pass in the feedback
+	float level = 0.8f;
+	bool ping_pong = true;
 };
 
 struct parameters {
-  std::array<param_track, 9> tracks;
-  param_master master;
+	param_master master;
+	std::array<param_track, MAX_TRACKS> tracks;
+	param_reverb reverb;
+	param_delay delay;
 };
+
+inline void parameters_init(parameters& p)
+{
+	p = parameters {};
+	p.master.velocity_sequence.data.fill(100);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+
+#include "dsp.hpp"
+
+// bank of pattern snapshots for switching between prepared patterns on stage. a
+// pattern is everything in `parameters` except the global settings (tempo, transport,
+// scale, reverb and delay). the bank belongs to the ui: to switch, it copies the next
+// pattern into the spare parameter buffer of the dsp and sends PARAM_CMD_PATTERN, and
+// the audio thread swaps its parameter pointer on the next bar. nothing is copied or
+// allocated on the audio thread.
+
+const int NUM_PATTERNS = 16;
+
+struct pattern_bank {
+	std::array<parameters, NUM_PATTERNS> patterns;
+	int current = 0; // the pattern the ui edits, playing or queued
+};
+
+// fills every slot with p
+void pattern_bank_init(pattern_bank& b, const parameters& p);
+
+// copies the global settings of `from` over those of `to`
+void pattern_keep_globals(parameters& to, const parameters& from);
+
+// ui side. stores `edited` as the current pattern and queues pattern `next` for the
+// next bar. `edited` and `sent` (see param_sync) become the next pattern with the
+// global settings kept. returns false, and changes nothing, while the audio thread
+// hasn't switched to the last queued pattern yet.
+bool pattern_queue(pattern_bank& b, int next, parameters& edited, parameters& sent,
+				   flechtbox_dsp& dsp);
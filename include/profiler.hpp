@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "parameters.hpp"
+
+// cost of every track and stage of a sub-block, as a fraction of the time the sub-block
+// lasts. ticks come from the time stamp counter where there is one and from
+// clock_gettime elsewhere. the audio thread keeps rolling averages and publishes them
+// once per sub-block for the ui.
+
+enum profile_stage {
+	PROFILE_TRACKS, // sequencing and rendering, the tracks in parallel if workers run
+	PROFILE_MIX,
+	PROFILE_EFFECTS, // reverb and delay
+	PROFILE_OUTPUT,
+	PROFILE_NUM_STAGES
+};
+
+struct profiler {
+	// fraction of the sub-block budget per tick
+	double load_per_tick = 0.0;
+
+	// rolling averages, only touched by the audio thread
+	std::array<float, MAX_TRACKS> track_avg {};
+	std::array<float, PROFILE_NUM_STAGES> stage_avg {};
+
+	// copies of the averages for the ui
+	std::array<std::atomic<float>, MAX_TRACKS> track_load {};
+	std::array<std::atomic<float>, PROFILE_NUM_STAGES> stage_load {};
+};
+
+uint64_t profile_ticks();
+
+// calibrates the tick rate on the first call, which takes a few milliseconds
+void profiler_init(profiler& p, double sub_block_seconds);
+
+// folds the ticks spent in one sub-block into the averages and publishes them.
+// track_ticks holds num_tracks entries, zero for tracks that weren't rendered.
+void profiler_add_sub_block(profiler& p, const uint64_t* track_ticks, int num_tracks,
+							const uint64_t* stage_ticks);
+
+const char* profile_stage_name(profile_stage stage);
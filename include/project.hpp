@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include "parameters.hpp"
+
+// binary project files: a header followed by `parameters` exactly as it is laid out in
+// memory. loading maps the file, checks it and copies it over, nothing is parsed or
+// allocated. any change to the layout of `parameters` has to bump PROJECT_VERSION.
+
+const uint32_t PROJECT_MAGIC = 0x58424c46; // "FLBX"
+const uint32_t PROJECT_VERSION = 5;
+
+struct project_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t payload_size; // sizeof(parameters)
+	uint32_t checksum;	   // fnv-1a of the payload
+};
+
+// the functions below return null on success and a message otherwise
+
+// writes to a temporary file next to path and renames it, so an existing project is
+// never left half written
+const char* project_save(const parameters& p, const char* path);
+
+// p is only changed if the file is a valid project. the transport state of p is kept.
+const char* project_load(parameters& p, const char* path);
+
+// checks that every enum, index and flag is in range, so a damaged file can't make the
+// sequencer or the engines read out of bounds
+const char* project_validate(const parameters& p);
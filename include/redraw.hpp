@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// tells the ui that something it shows has changed. the ui blocks on the flag word
+// (a futex on linux) and the raising side only makes the wake-up call when the ui is
+// registered as waiting, the way a fork wakes sleeping workers, so the audio thread
+// makes at most one system call per frame and a quiet display costs no wake-ups.
+struct redraw_signal {
+	// 1 while raised and not yet taken by the ui
+	std::atomic<uint32_t> pending {0};
+	std::atomic<int> waiters {0};
+	std::atomic<bool> closed {false};
+
+	// ui side only, frames are at least an interval apart
+	std::chrono::steady_clock::time_point last_frame {};
+};
+
+// any thread, the audio thread included
+void redraw_signal_raise(redraw_signal& s);
+
+// blocks until the signal is raised and takes it, but not before an interval has passed
+// since it last returned, so changes raised in between go into the same frame. false
+// once it is closed.
+bool redraw_signal_wait(redraw_signal& s, std::chrono::microseconds interval);
+
+// ends the wait for good
+void redraw_signal_close(redraw_signal& s);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <memory>
+
+#include "dsp.hpp"
+
+// renders `bars` bars of the current pattern to a 32 bit float wav file as fast as
+// possible, without opening an audio device. dsp has to be initialized. returns a
+// process exit code.
+int render_run(std::shared_ptr<flechtbox_dsp> dsp, const char* path, int bars);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// polyphase windowed sinc resampler for interleaved stereo, used to run the synth at
+// 48 kHz on devices with another rate. any ratio works: the filter is tabulated for
+// RESAMPLER_PHASES fractional positions and interpolated linearly between them.
+// the input is pulled through a callback whenever more is needed.
+
+const int RESAMPLER_TAPS = 64;
+const int RESAMPLER_PHASES = 128;
+
+// writes `frames` frames of interleaved stereo input to out
+typedef void (*resampler_fill_fn)(void* ctx, float* out, int frames);
+
+struct resampler {
+	double ratio = 1.0; // input frames per output frame
+	double pos = 0.0;	// input position of the next output frame, from history start
+
+	// (RESAMPLER_PHASES + 1) * RESAMPLER_TAPS coefficients, phase by phase
+	std::vector<float> coeffs;
+
+	// planar input history per channel and how many frames of it are filled
+	std::vector<float> history[2];
+	int available = 0;
+
+	// the callback always delivers blocks of this size
+	int fill_frames = 0;
+	std::vector<float> fill_buffer;
+};
+
+// allocates everything, no allocation happens in resampler_process
+void resampler_init(resampler& r, double in_rate, double out_rate, int fill_frames);
+
+void resampler_process(resampler& r, float* out, int frames, resampler_fill_fn fill,
+					   void* ctx);
@@ -33,7 +33,6 @@
 
 #include <clouds/dsp/fx/fx_engine.h>
 #include <stmlib/stmlib.h>
-#include <vector>
 
 struct clouds_reverb {
 	typedef clouds::FxEngine<16384, clouds::FORMAT_12_BIT> E;
@@ -51,17 +50,18 @@ struct clouds_reverb {
 	// DISALLOW_COPY_AND_ASSIGN(clouds_reverb);
 };
 
-inline void clouds_reverb_init(clouds_reverb& r, uint16_t* buffer)
+inline void clouds_reverb_init(clouds_reverb& r, uint16_t* buffer, float samplerate)
 {
+	// the lfo rates were tuned for 32 kHz and have always run at 48 kHz, where they
+	// come out at 0.75 Hz and 0.45 Hz. those are kept at any other rate.
 	r.engine_.Init(buffer);
-	r.engine_.SetLFOFrequency(clouds::LFO_1, 0.5f / 32000.0f);
-	r.engine_.SetLFOFrequency(clouds::LFO_2, 0.3f / 32000.0f);
+	r.engine_.SetLFOFrequency(clouds::LFO_1, 0.5f / 32000.0f * (48000.0f / samplerate));
+	r.engine_.SetLFOFrequency(clouds::LFO_2, 0.3f / 32000.0f * (48000.0f / samplerate));
 	r.lp_ = 0.7f;
 	r.diffusion_ = 0.625f;
 }
 
-inline void clouds_reverb_process(clouds_reverb& r, std::vector<float*> in_out,
-								  size_t block_size)
+inline void clouds_reverb_process(clouds_reverb& r, float** in_out, size_t block_size)
 {
 	// This is the Griesinger topology described in the Dattorro paper
 	// (4 AP diffusers on the input, then a loop of 2x 2AP+1Delay).
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stmlib/dsp/cosine_oscillator.h>
+
+#include "arena.hpp"
+
+// float version of clouds_reverb, same topology and settings. the delay lines are
+// power of two rings of 32 bit floats instead of one 12 bit buffer, so nothing is
+// compressed and nothing saturates, at about three times the memory. the input
+// diffusers run over the block first, then the two branches of the reverb loop run side
+// by side in the two lanes of a float vector.
+
+// one ring per delay line. the loop lines hold both branches interleaved, lane 0 is
+// the left branch and lane 1 the right one.
+struct float_reverb_line {
+	float* data = nullptr;
+	uint32_t mask = 0;
+};
+
+struct float_reverb {
+	const float amount = 1.f; // fully wet
+	float input_gain = 0.2f;
+	float reverb_time = 0.25f;
+	float diffusion = 0.625f;
+	float lp = 0.7f;
+
+	float_reverb_line ap[4];
+	float_reverb_line loop_ap_a;
+	float_reverb_line loop_ap_b;
+	float_reverb_line loop_delay;
+
+	float lp_decay[2] = {0.f, 0.f};
+
+	stmlib::CosineOscillator lfo[2];
+	float lfo_value[2] = {0.f, 0.f};
+
+	// advances by one every sample, all lines share it
+	uint32_t write_ptr = 0;
+
+	// output of the input diffusers and the loop modulation of the current block
+	float* diffused = nullptr;
+	float* modulation = nullptr;
+};
+
+// what float_reverb_init takes of the arena
+size_t float_reverb_memory(size_t max_block_size);
+
+// takes the delay lines from the arena, blocks passed to float_reverb_process can be up
+// to max_block_size samples long (at most 64). false if the arena is too small.
+bool float_reverb_init(float_reverb& r, size_t max_block_size, float samplerate,
+					   arena& memory);
+
+void float_reverb_process(float_reverb& r, float** in_out, size_t block_size);
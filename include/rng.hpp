@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+// pcg32 after melissa o'neill (pcg-random.org): 64 bits of state, a few instructions
+// per draw, no allocation. every track and every sequence owns one, so the sequence of
+// draws only depends on the seed and not on how the tracks are spread over threads.
+struct rng32 {
+	uint64_t state = 0x853c49e6748fea9bull;
+	uint64_t inc = 0xda3e39cb94b95bdbull;
+};
+
+inline uint32_t rng_next(rng32& r)
+{
+	const uint64_t old = r.state;
+	r.state = old * 6364136223846793005ull + r.inc;
+	const uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+	const uint32_t rot = (uint32_t)(old >> 59u);
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+// generators with the same seed but another stream never produce the same sequence
+inline void rng_seed(rng32& r, uint64_t seed, uint64_t stream)
+{
+	r.state = 0;
+	r.inc = (stream << 1u) | 1u;
+	rng_next(r);
+	r.state += seed;
+	rng_next(r);
+}
+
+// 0 to n - 1, by a multiply and a shift instead of a division
+inline uint32_t rng_below(rng32& r, uint32_t n)
+{
+	return (uint32_t)(((uint64_t)rng_next(r) * n) >> 32);
+}
+
+// true with a chance of percent in 100, in integers. certain outcomes draw nothing.
+inline bool rng_chance(rng32& r, int percent)
+{
+	if (percent <= 0) return false;
+	if (percent >= 100) return true;
+	return (int)rng_below(r, 100) < percent;
+}
+
+// -0.5 to 0.5, from the upper 24 bits
+inline float rng_bipolar(rng32& r)
+{
+	return (rng_next(r) >> 8) * (1.f / 16777216.f) - 0.5f;
+}
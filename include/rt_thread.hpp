@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// setting up the threads that render audio: real-time priority, a core of their own
+// and denormals flushed to zero. each step can fail on its own, mostly for lack of
+// permissions (rtprio and memlock in /etc/security/limits.conf), and the result says
+// which ones did.
+
+struct rt_thread_options {
+	int priority = 0;	// SCHED_FIFO priority, 0 leaves the policy as it is
+	int cpu = -1;		// core to pin the thread to, -1 leaves the affinity as it is
+	bool flush_denormals = false;
+};
+
+struct rt_thread_result {
+	bool priority = false;
+	bool pinned = false;
+	bool flush_denormals = false;
+};
+
+// SCHED_FIFO priority for the audio thread, the workers run one below
+const int RT_AUDIO_PRIORITY = 80;
+
+// applies the options to the calling thread. threads it creates afterwards inherit
+// all three, that is how the callback thread of the audio host gets them.
+rt_thread_result rt_thread_setup(const rt_thread_options& o);
+
+// one line per thread, with what was asked for and whether it worked
+void rt_thread_print(const char* name, const rt_thread_options& o,
+					 const rt_thread_result& r, FILE* f);
+
+// moves the calling thread onto every online core except `cpus`, so it and the threads
+// it creates later stay off the audio cores. false if no core is left or that fails.
+bool rt_thread_avoid(const std::vector<int>& cpus);
+
+// sets or clears flush-to-zero and denormals-are-zero for the calling thread. false
+// where the cpu has no such mode.
+bool rt_flush_denormals(bool on);
+
+// locks every page of the process into memory, and with an unlimited memlock limit
+// every page mapped from now on as well. false if that isn't allowed.
+bool rt_lock_memory(bool& future);
@@ -0,0 +1,30 @@
+#pragma once
+
+// real-time safety checker. in builds configured with -DFLECHTBOX_RTCHECK=ON, memory
+// allocation, mutex locks, condition variable and semaphore waits, sleeps and reads and
+// writes of file descriptors are intercepted and reported with a backtrace while the
+// calling thread is inside an rt_section. raw system calls made through syscall(), such
+// as futex waits, are not. otherwise this compiles to nothing.
+
+#ifdef FLECHTBOX_RTCHECK
+// resolves the intercepted functions, call once at startup before any rt_section
+void rt_check_init();
+void rt_section_enter();
+void rt_section_leave();
+// number of violations reported since startup
+long rt_check_violations();
+#else
+inline void rt_check_init() {}
+inline void rt_section_enter() {}
+inline void rt_section_leave() {}
+inline long rt_check_violations() { return 0; }
+#endif
+
+// marks the enclosing scope as real-time, sections may nest
+struct rt_section {
+	rt_section() { rt_section_enter(); }
+	~rt_section() { rt_section_leave(); }
+
+	rt_section(const rt_section&) = delete;
+	rt_section& operator=(const rt_section&) = delete;
+};
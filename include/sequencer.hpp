@@ -2,55 +2,62 @@
 
 #include <array>
 #include <climits>
-#include <cstdlib>
-#include <ctime>
 
 #include "clock.hpp"
+#include "parameters.hpp"
+#include "rng.hpp"
 
 const int SEQ_NULL = INT_MIN;
 
-enum playback_directions {
-	PB_FORWARD,
-	PB_BACKWARD,
-	PB_PENDULUM,
-	PB_RANDOM
-};
-
+// playback state of a sequence, its settings and steps live in param_seq
 struct track_seq {
 	unsigned int current_pos = 0;
-	int length = 10;
-	int playback_dir = PB_FORWARD;
-	std::array<int, 10> data;
 	bool pendulum_forward = true;
-	clock_division division = CL_SIXTEENTH;
-	int last_value;
+	int last_value = 0;
+	rng32 rng; // for random playback
 };
 
-inline void track_seq_init(track_seq& t) { t.data.fill(0); }
+// moves the play head so that the next step it lands on is the first one of the
+// playback direction
+inline void track_seq_rewind(track_seq& t, const param_seq& p)
+{
+	switch (p.playback_dir) {
+	case PB_FORWARD:
+		t.current_pos = p.length - 1;
+		break;
+	case PB_PENDULUM:
+		t.current_pos = 1;
+		t.pendulum_forward = false;
+		break;
+	default:
+		t.current_pos = 0;
+		break;
+	}
+}
 
 inline int
-track_seq_process_step(track_seq& t,
+track_seq_process_step(track_seq& t, const param_seq& p,
 					   const std::array<bool, CL_NUM_CLOCK_DIVISIONS>& clock_states)
 {
 	// only process if we land on a division
-	if (!clock_states[t.division]) return SEQ_NULL;
+	if (!clock_states[p.division]) return SEQ_NULL;
 
 	// read current position
 	int tmp_pos = t.current_pos;
 
 	// play head advancement
-	if (t.playback_dir == PB_FORWARD ||
-		(t.playback_dir == PB_PENDULUM && t.pendulum_forward))
+	if (p.playback_dir == PB_FORWARD ||
+		(p.playback_dir == PB_PENDULUM && t.pendulum_forward))
 		tmp_pos++;
-	else if (t.playback_dir == PB_BACKWARD ||
-			 (t.playback_dir == PB_PENDULUM && !t.pendulum_forward))
+	else if (p.playback_dir == PB_BACKWARD ||
+			 (p.playback_dir == PB_PENDULUM && !t.pendulum_forward))
 		tmp_pos--;
-	else if (t.playback_dir == PB_RANDOM) tmp_pos = rand() % t.length;
+	else if (p.playback_dir == PB_RANDOM) tmp_pos = rng_below(t.rng, p.length);
 
-	const int max_index = t.length - 1;
+	const int max_index = p.length - 1;
 
 	// play head reset
-	switch (t.playback_dir) {
+	switch (p.playback_dir) {
 	case PB_FORWARD:
 		if (tmp_pos > max_index) tmp_pos = 0;
 		break;
@@ -65,9 +72,13 @@ track_seq_process_step(track_seq& t,
 		break;
 	}
 
+	// the length may have shrunk since the last step
+	if (tmp_pos < 0) tmp_pos = 0;
+	else if (tmp_pos > max_index) tmp_pos = max_index;
+
 	// write current position
 	t.current_pos = tmp_pos;
 
-	t.last_value = t.data[t.current_pos];
+	t.last_value = p.data[t.current_pos];
 	return t.last_value;
 }
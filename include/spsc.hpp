@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// bounded single producer, single consumer ring buffer. push and pop are wait-free and
+// never allocate, so either side may be a real-time thread.
+template <typename T, size_t N>
+struct spsc_queue {
+	static_assert((N & (N - 1)) == 0, "spsc_queue size must be a power of two");
+
+	std::array<T, N> items;
+
+	// on separate cache lines so producer and consumer don't share one
+	alignas(64) std::atomic<size_t> head {0}; // next item to pop, written by the consumer
+	alignas(64) std::atomic<size_t> tail {0}; // next free slot, written by the producer
+};
+
+// returns false if the queue is full
+template <typename T, size_t N>
+inline bool spsc_queue_push(spsc_queue<T, N>& q, const T& item)
+{
+	const size_t tail = q.tail.load(std::memory_order_relaxed);
+	if (tail - q.head.load(std::memory_order_acquire) == N) return false;
+
+	q.items[tail & (N - 1)] = item;
+	q.tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+// returns false if the queue is empty
+template <typename T, size_t N>
+inline bool spsc_queue_pop(spsc_queue<T, N>& q, T& item)
+{
+	const size_t head = q.head.load(std::memory_order_relaxed);
+	if (head == q.tail.load(std::memory_order_acquire)) return false;
+
+	item = q.items[head & (N - 1)];
+	q.head.store(head + 1, std::memory_order_release);
+	return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+// timing of the audio callback. the audio thread records every callback with relaxed
+// atomics, the ui and the exit dump read them at any time. nothing locks or allocates.
+
+// render time as a fraction of the buffer duration, in bins of 5 %. the last bin
+// collects everything from 115 % up.
+const int STATS_LOAD_BINS = 24;
+const float STATS_LOAD_BIN_WIDTH = 0.05f;
+
+struct audio_stats {
+	std::array<std::atomic<uint64_t>, STATS_LOAD_BINS> load_histogram {};
+	std::atomic<uint64_t> callbacks {0};
+	// callbacks that took longer than their buffer lasts
+	std::atomic<uint64_t> late {0};
+	// output underflows and overflows reported by the host
+	std::atomic<uint64_t> underflows {0};
+	std::atomic<uint64_t> overflows {0};
+
+	// load of the last callbacks, smoothed, and the highest one since the ui last took
+	// it. max_load never resets.
+	std::atomic<float> load {0.f};
+	std::atomic<float> peak_load {0.f};
+	std::atomic<float> max_load {0.f};
+
+	// time from the callback to the dac, as the host reports it, in seconds
+	std::atomic<double> output_latency {0.0};
+};
+
+// monotonic time in nanoseconds, cheap enough to call twice per callback
+uint64_t stats_now();
+
+// records one callback that started at `start` and rendered `frames` frames at
+// `samplerate`. latency is negative when the host doesn't report one.
+void stats_record(audio_stats& s, uint64_t start, unsigned long frames, double samplerate,
+				  bool underflow, bool overflow, double latency);
+
+// the peak load since the last call
+float stats_take_peak(audio_stats& s);
+
+// xruns as the host counts them
+inline uint64_t stats_xruns(const audio_stats& s)
+{
+	return s.underflows.load(std::memory_order_relaxed) +
+		   s.overflows.load(std::memory_order_relaxed);
+}
+
+// counters and the load histogram in plain text
+void stats_print(const audio_stats& s, FILE* f);
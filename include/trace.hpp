@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "stats.hpp"
+
+// timeline of the audio callbacks, sub-blocks, triggers and ui frames in the chrome
+// trace event format, for chrome://tracing or ui.perfetto.dev. any thread can record
+// events: they go into a preallocated lock-free ring and a background thread writes
+// them to the file. when the ring is full events are dropped and counted. while no
+// trace runs, recording an event costs one relaxed load.
+
+// the timeline rows
+enum trace_thread { TRACE_AUDIO = 1, TRACE_UI, TRACE_UI_REDRAW };
+
+extern std::atomic<bool> trace_active;
+
+// opens the file and starts the writer thread, returns false if the file can't be
+// opened
+bool trace_start(const char* path);
+
+// writes what is left in the ring and closes the file
+void trace_stop();
+
+// an event from start to end, times from stats_now(). arg_name may be null.
+void trace_record_complete(const char* name, trace_thread thread, uint64_t start,
+						   uint64_t end, const char* arg_name, int64_t arg);
+
+// an event without duration at the current time
+void trace_record_instant(const char* name, trace_thread thread, const char* arg_name,
+						  int64_t arg);
+
+// names have to be string literals, the writer reads them later
+inline void trace_complete(const char* name, trace_thread thread, uint64_t start,
+						   uint64_t end, const char* arg_name = nullptr, int64_t arg = 0)
+{
+	if (trace_active.load(std::memory_order_acquire))
+		trace_record_complete(name, thread, start, end, arg_name, arg);
+}
+
+inline void trace_instant(const char* name, trace_thread thread,
+						  const char* arg_name = nullptr, int64_t arg = 0)
+{
+	if (trace_active.load(std::memory_order_acquire))
+		trace_record_instant(name, thread, arg_name, arg);
+}
+
+// records the enclosing scope as one event
+struct trace_scope {
+	const char* name;
+	trace_thread thread;
+	uint64_t start;
+
+	trace_scope(const char* name, trace_thread thread)
+		: name(name), thread(thread),
+		  start(trace_active.load(std::memory_order_acquire) ? stats_now() : 0)
+	{
+	}
+	~trace_scope()
+	{
+		if (start) trace_record_complete(name, thread, start, stats_now(), nullptr, 0);
+	}
+
+	trace_scope(const trace_scope&) = delete;
+	trace_scope& operator=(const trace_scope&) = delete;
+};
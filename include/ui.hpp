@@ -4,5 +4,8 @@
 
 #include "audio.hpp"
 
+// ctrl+s saves the parameters to project_path, ctrl+o loads them from there. the
+// screen is redrawn on input and when the dsp has news, at most fps times a second.
 void ui_run(ftxui::ScreenInteractive &screen,
-            std::shared_ptr<flechtbox_dsp> dsp);
+            std::shared_ptr<flechtbox_dsp> dsp, const char *project_path,
+            int fps);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// pool of worker threads for fork/join parallelism on the audio thread. the caller of
+// worker_pool_join takes part in the work and returns once every job is done. nothing
+// in the fork/join path locks or allocates. idle workers spin briefly and then sleep
+// until the next fork, so a stopped stream doesn't keep their cores busy.
+typedef void (*worker_job_fn)(void* ctx, int job);
+
+struct worker_pool {
+	std::vector<std::thread> threads;
+	std::atomic<bool> quit {false};
+
+	worker_job_fn fn = nullptr;
+	void* ctx = nullptr;
+
+	// bumped once per fork to wake the workers
+	std::atomic<uint32_t> generation {0};
+	// workers sleeping on `generation`, a fork only makes the wake-up call if any are
+	std::atomic<int> sleepers {0};
+	// upper 32 bits: number of jobs, lower 32 bits: next job to hand out
+	std::atomic<uint64_t> ticket {0};
+	std::atomic<int> jobs_done {0};
+
+	~worker_pool();
+};
+
+// starts num_workers threads that run fn(ctx, job). cpus optionally lists the cores
+// the workers are pinned to, round robin. with realtime they run one below the audio
+// thread's SCHED_FIFO priority where allowed and flush denormals like it, see
+// rt_thread.hpp. returns once every worker is set up, having reported it to stderr.
+void worker_pool_start(worker_pool& p, int num_workers, worker_job_fn fn, void* ctx,
+					   const std::vector<int>& cpus = {}, bool realtime = false);
+
+void worker_pool_stop(worker_pool& p);
+
+// hands out jobs 0 to num_jobs - 1 to the workers and returns immediately, so the
+// calling thread can do other work before joining.
+void worker_pool_fork(worker_pool& p, int num_jobs);
+
+// helps with the remaining jobs and returns once all jobs of the last fork are done.
+void worker_pool_join(worker_pool& p, int num_jobs);
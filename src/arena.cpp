@@ -0,0 +1,74 @@
+#include <cstring>
+#include <sys/mman.h>
+
+#include "arena.hpp"
+
+#if defined(__linux__)
+static const size_t kHugePageSize = 2 * 1024 * 1024;
+#endif
+
+bool arena_init(arena& a, size_t size)
+{
+	arena_free(a);
+	if (size == 0) size = ARENA_ALIGN;
+
+	void* p = MAP_FAILED;
+#if defined(__linux__)
+	// explicit huge pages only exist if the admin reserved some, most systems have
+	// transparent ones instead. MAP_POPULATE faults everything in right here.
+	const size_t huge_size = (size + kHugePageSize - 1) & ~(kHugePageSize - 1);
+	p = mmap(nullptr, huge_size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+	if (p != MAP_FAILED) {
+		a.huge_pages = true;
+		size = huge_size;
+	} else {
+		p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+		if (p != MAP_FAILED) madvise(p, size, MADV_HUGEPAGE);
+	}
+#else
+	p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+#endif
+	if (p == MAP_FAILED) return false;
+
+	a.base = static_cast<char*>(p);
+	a.size = size;
+	a.used = 0;
+
+	// without the privilege to lock, the pages are still touched once so that at
+	// least the first callback doesn't fault them in
+	a.locked = mlock(a.base, a.size) == 0;
+	if (!a.locked) memset(a.base, 0, a.size);
+	return true;
+}
+
+void* arena_alloc(arena& a, size_t size)
+{
+	const size_t rounded = arena_round(size);
+	if (!a.base || rounded > a.size - a.used) return nullptr;
+	void* p = a.base + a.used;
+	a.used += rounded;
+	return p;
+}
+
+void arena_free(arena& a)
+{
+	if (!a.base) return;
+	if (a.locked) munlock(a.base, a.size);
+	munmap(a.base, a.size);
+	a.base = nullptr;
+	a.size = 0;
+	a.used = 0;
+	a.huge_pages = false;
+	a.locked = false;
+}
+
+arena::~arena() { arena_free(*this); }
+
+void arena_print(const arena& a, FILE* f)
+{
+	fprintf(f, "dsp memory:     %zu kB in %zu kB, %s pages, %s\n", a.used / 1024,
+			a.size / 1024, a.huge_pages ? "huge" : "normal",
+			a.locked ? "locked" : "not locked");
+}
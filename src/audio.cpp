@@ -1,26 +1,34 @@
+#include <algorithm>
 #include <cstdio>
 #include <memory>
 
 #include "audio.hpp"
 #include "dsp.hpp"
+#include "rtcheck.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 
-void audio_run(std::shared_ptr<flechtbox_dsp> dsp)
+void audio_run(std::shared_ptr<flechtbox_dsp> dsp, rt_thread_options rt,
+			   std::promise<rt_thread_result> setup)
 {
-	// init dsp
-	dsp_init(dsp);
+	setup.set_value(rt_thread_setup(rt));
 
 	// init portaudio
 	PaStream* stream;
 	PaError err;
 
+	// any host buffer size works, the dsp renders through a fifo
+	const unsigned long frames_per_buffer =
+		dsp->buffer_size > 0 ? dsp->buffer_size : paFramesPerBufferUnspecified;
+
 	err = Pa_Initialize();
 	if (err != paNoError) goto error;
 
 	/* Open an audio I/O stream. */
-	err = Pa_OpenDefaultStream(&stream, 0,			  /* no input channels */
-							   2,					  /* stereo output */
-							   paFloat32,			  /* 32 bit floating point output */
-							   SAMPLERATE, BLOCKSIZE, /* frames per buffer */
+	err = Pa_OpenDefaultStream(&stream, 0,					  /* no input channels */
+							   2,							  /* stereo output */
+							   paFloat32,					  /* 32 bit floating point output */
+							   dsp->samplerate, frames_per_buffer, /* frames per buffer */
 							   portaudio_callback, &dsp);
 
 	if (err != paNoError) goto error;
@@ -59,6 +67,9 @@ int portaudio_callback(const void* input, void* outputBuffer,
 					   const PaStreamCallbackTimeInfo* timeInfo,
 					   PaStreamCallbackFlags statusFlags, void* userData)
 {
+	rt_section rt;
+	const uint64_t start = stats_now();
+
 	/* Cast data passed through stream to our structure. */
 	std::shared_ptr<flechtbox_dsp>* dsp = (std::shared_ptr<flechtbox_dsp>*)userData;
 
@@ -66,7 +77,26 @@ int portaudio_callback(const void* input, void* outputBuffer,
 
 	(void)input; /* Prevent unused variable warning. */
 
+	// the host may call from a thread that didn't inherit the setting, writing the
+	// control register costs next to nothing
+	if ((*dsp)->realtime) rt_flush_denormals(true);
+
+	// not every host knows when the buffer reaches the dac
+	const double latency = (timeInfo && timeInfo->outputBufferDacTime > 0.0)
+							   ? timeInfo->outputBufferDacTime - timeInfo->currentTime
+							   : -1.0;
+
+	// midi clock timing is relative to the dac where the host tells
+	const uint64_t dac_time = start + (uint64_t)(std::max(latency, 0.0) * 1e9);
+	midi_sync_callback((*dsp)->midi, dac_time, framesPerBuffer);
+
 	dsp_process_block(*dsp, out, framesPerBuffer);
+	stats_record((*dsp)->stats, start, framesPerBuffer, (*dsp)->samplerate,
+				 statusFlags & paOutputUnderflow, statusFlags & paOutputOverflow, latency);
+
+	trace_complete("callback", TRACE_AUDIO, start, stats_now(), "frames", framesPerBuffer);
+	if (statusFlags & (paOutputUnderflow | paOutputOverflow))
+		trace_instant("xrun", TRACE_AUDIO, "flags", statusFlags);
 
 	return 0;
 }
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "delay.hpp"
+
+typedef float v2sf __attribute__((vector_size(8)));
+
+// the ring holds at least this long a delay, a half note at 60 bpm
+static const float kMaxSeconds = 2.f;
+static const float kGlideSeconds = 0.05f;
+// the low cut in the feedback, so repeats don't pile up bass
+static const float kHighPassHz = 120.f;
+
+// see reverb_float.cpp, the low cut would otherwise let the tail decay into denormals
+static const float kAntiDenormal = 1e-20f;
+
+static uint32_t ring_frames(float samplerate)
+{
+	// the interpolation reads one frame further back
+	const uint32_t length = (uint32_t)std::ceil(kMaxSeconds * samplerate) + 2;
+	uint32_t size = 1;
+	while (size < length) size <<= 1;
+	return size;
+}
+
+size_t float_delay_memory(float samplerate)
+{
+	return arena_round(ring_frames(samplerate) * 2 * sizeof(float));
+}
+
+// the arena hands out zeroed memory
+bool float_delay_init(float_delay& d, float samplerate, arena& memory)
+{
+	const uint32_t frames = ring_frames(samplerate);
+	d.data = static_cast<float*>(arena_alloc(memory, frames * 2 * sizeof(float)));
+	d.mask = frames - 1;
+	d.samplerate = samplerate;
+	d.glide = 1.f - std::exp(-1.f / (kGlideSeconds * samplerate));
+	d.hp_coefficient = 1.f - std::exp(-2.f * (float)M_PI * kHighPassHz / samplerate);
+	return d.data != nullptr;
+}
+
+void float_delay_set_time(float_delay& d, float seconds)
+{
+	const float longest = (float)(d.mask - 1);
+	float target = std::max(seconds * d.samplerate, 1.f);
+	while (target > longest) target *= 0.5f;
+	d.target = target;
+
+	// nothing to glide from yet
+	if (d.time == 0.f) d.time = target;
+}
+
+static inline v2sf ring_read(const float_delay& d, uint32_t frame)
+{
+	v2sf v;
+	memcpy(&v, &d.data[(frame & d.mask) * 2], sizeof(v));
+	return v;
+}
+
+void float_delay_process(float_delay& d, const float* in, float** out, size_t block_size)
+{
+	const float feedback = d.feedback;
+	const float klp = d.lp;
+	const float khp = d.hp_coefficient;
+	const float level = d.level;
+	const bool ping_pong = d.ping_pong;
+
+	v2sf lp_state = {d.lp_state[0], d.lp_state[1]};
+	v2sf hp_state = {d.hp_state[0], d.hp_state[1]};
+	float time = d.time;
+	uint32_t w = d.write_ptr;
+
+	// the delay is at least a frame, so every read is of a frame written before
+	for (size_t i = 0; i < block_size; i++) {
+		++w;
+		time += (d.target - time) * d.glide;
+
+		const uint32_t integral = (uint32_t)time;
+		const float fractional = time - integral;
+		const v2sf a = ring_read(d, w - integral);
+		const v2sf b = ring_read(d, w - integral - 1);
+		const v2sf tap = a + (b - a) * fractional;
+
+		out[0][i] += tap[0] * level;
+		out[1][i] += tap[1] * level;
+
+		lp_state += klp * (tap - lp_state);
+		hp_state += khp * (lp_state - hp_state);
+		v2sf repeat = (lp_state - hp_state) * feedback;
+
+		// ping-pong feeds the send to the left only and crosses the repeats over
+		v2sf x = {in[i], in[i]};
+		if (ping_pong) {
+			x[1] = 0.f;
+			repeat = v2sf {repeat[1], repeat[0]};
+		}
+		x += repeat + kAntiDenormal;
+		memcpy(&d.data[(w & d.mask) * 2], &x, sizeof(x));
+	}
+
+	d.lp_state[0] = lp_state[0];
+	d.lp_state[1] = lp_state[1];
+	d.hp_state[0] = hp_state[0];
+	d.hp_state[1] = hp_state[1];
+	d.time = time;
+	d.write_ptr = w;
+}
@@ -1,41 +1,219 @@
 #include "dsp.hpp"
 #include "audio_buffer.h"
 #include "clock.hpp"
+#include "mix.hpp"
 #include "reverb.hpp"
+#include "rtcheck.hpp"
 #include "sequencer.hpp"
+#include "trace.hpp"
+#include <algorithm>
 #include <array>
 #include <cstdlib>
-#include <random>
+#include <stmlib/utils/random.h>
 
 float plaits::kSampleRate = SAMPLERATE;
 float plaits::kCorrectedSampleRate = SAMPLERATE;
 float plaits::a0 = (440.0f / 8.0f) / plaits::kCorrectedSampleRate;
 
 static constexpr size_t kReverbBufferSize = 16384;
-static uint16_t reverb_buffer[kReverbBufferSize] = {0};
+static constexpr size_t kVoiceBufferSize = PLAITS_BLOCKSIZE * 1024;
 
-void dsp_init(std::shared_ptr<flechtbox_dsp> dsp)
+// how often per second the ui is woken for the meters while the transport runs
+static constexpr double kMeterRate = 4.0;
+
+// engines that draw from stmlib::Random, whose state is a single global. these are
+// always rendered on the audio thread in track order, so the random sequence and
+// with it the output is the same whether or not the worker pool is used.
+static bool engine_uses_shared_rng(int engine)
 {
-	dsp->clock.samplerate = SAMPLERATE;
+	switch (engine) {
+	case 2: // fm 1 to 3, the sample and hold of the dx7 lfo
+	case 3:
+	case 4:
+	case 7: // arpeggiator, whose random mode draws on every note
+	case 15: // speech, swarm, noise, dust, rings a/b, kick, snare, hihat
+	case 16:
+	case 17:
+	case 18:
+	case 19:
+	case 20:
+	case 21:
+	case 22:
+	case 23: return true;
+	default: return false;
+	}
+}
+
+// a note landing mid sub-block switches to split_patch halfway through the render,
+// whose engine may be locked to another one than the voice played so far
+static bool voice_uses_shared_rng(const track_voice& v)
+{
+	return engine_uses_shared_rng(v.plaits_patch.engine) ||
+		   (v.split > 0 && engine_uses_shared_rng(v.split_patch.engine));
+}
+
+// the track settings with the locked ones replaced, a select per target
+static void patch_apply_settings(plaits::Patch& patch, const param_track& p,
+								 const step_lock& lock, float harmonics_rand,
+								 float timbre_rand, float morph_rand)
+{
+	std::array<float, PL_NUM_TARGETS> v = {p.harmonics, p.timbre, p.morph, p.decay,
+										   (float)p.engine};
+	for (int k = 0; k < PL_NUM_TARGETS; k++)
+		v[k] = ((lock.mask >> k) & 1) ? lock.values[k] : v[k];
+
+	patch.engine = (int)v[PL_ENGINE];
+	patch.decay = v[PL_DECAY];
+	patch.lpg_colour = p.lpg_colour;
+	patch.harmonics = v[PL_HARMONICS] + harmonics_rand;
+	patch.timbre = v[PL_TIMBRE] + timbre_rand;
+	patch.morph = v[PL_MORPH] + morph_rand;
+}
+
+static void voice_render(track_voice& v)
+{
+	const uint64_t start = profile_ticks();
+
+	if (v.split > 0) {
+		// the trigger written CLOCK_LOOKAHEAD sub-blocks ago fires on the second render
+		v.voice->Render(v.plaits_patch, v.plaits_mods, v.frames, v.split);
+		v.plaits_patch = v.split_patch;
+		v.voice->Render(v.plaits_patch, v.plaits_mods, v.frames + v.split,
+						PLAITS_BLOCKSIZE - v.split);
+	} else {
+		v.voice->Render(v.plaits_patch, v.plaits_mods, v.frames, PLAITS_BLOCKSIZE);
+	}
+	v.plaits_mods.trigger = 0.f;
 
-	for (int i = 0; i < NUM_TRACKS; i++) { flechtbox_track_init(dsp->tracks[i]); }
+	int peak = 0;
+	for (int i = 0; i < PLAITS_BLOCKSIZE; i++) peak = std::max(peak, std::abs(v.frames[i].out));
+	v.peak = peak;
+	v.silent_blocks = peak > SILENCE_THRESHOLD ? 0 : v.silent_blocks + 1;
 
-	track_seq_init(dsp->pitch_sequence);
-	track_seq_init(dsp->octave_sequence);
-	dsp->velocity_sequence.data.fill(100);
+	v.render_ticks = profile_ticks() - start;
+}
+
+static void voice_render_job(void* ctx, int job)
+{
+	rt_section rt;
+	auto& dsp = *static_cast<flechtbox_dsp*>(ctx);
+	voice_render(dsp.voices[dsp.worker_jobs[job]]);
+}
+
+// the voice a new note takes: one that went silent, or else the quietest, the oldest
+// of equally quiet ones. the note it played is cut off.
+static int track_pick_voice(const flechtbox_track& t)
+{
+	int best = 0;
+	for (int k = 1; k < t.num_voices; k++) {
+		const auto& v = t.voices[k];
+		const auto& b = t.voices[best];
+		const bool silent = v.silent_blocks >= SILENCE_HANGOVER;
+		const bool best_silent = b.silent_blocks >= SILENCE_HANGOVER;
+		if (silent != best_silent) {
+			if (silent) best = k;
+			continue;
+		}
+		if (v.peak < b.peak || (v.peak == b.peak && v.started < b.started)) best = k;
+	}
+	return best;
+}
+
+double dsp_synth_rate(const flechtbox_dsp& dsp)
+{
+	return dsp.resample ? SAMPLERATE : dsp.samplerate;
+}
+
+bool dsp_init(std::shared_ptr<flechtbox_dsp> dsp)
+{
+	// resampling to the rate the synth runs at anyway would only cost
+	if (dsp->samplerate == SAMPLERATE) dsp->resample = false;
+
+	// plaits reads these while its voices are initialized, so they go first
+	const double rate = dsp_synth_rate(*dsp);
+	plaits::kSampleRate = rate;
+	plaits::kCorrectedSampleRate = rate;
+	plaits::a0 = (440.0f / 8.0f) / plaits::kCorrectedSampleRate;
+
+	dsp->clock.samplerate = rate;
+	midi_sync_init(dsp->midi, dsp->samplerate, rate);
+	profiler_init(dsp->profile, PLAITS_BLOCKSIZE / rate);
+
+	if (dsp->resample)
+		resampler_init(dsp->output_resampler, SAMPLERATE, dsp->samplerate, PLAITS_BLOCKSIZE);
+
+	for (auto& p : dsp->param_buffers) parameters_init(p);
+
+	mix_init();
+
+	// every track and voice up front, nothing is allocated once the audio runs
+	dsp->num_tracks = std::clamp(dsp->num_tracks, 1, MAX_TRACKS);
+	dsp->voices_per_track = std::clamp(dsp->voices_per_track, 1, MAX_VOICES);
+	const int num_voices = dsp->num_tracks * dsp->voices_per_track;
+	dsp->tracks = std::vector<flechtbox_track>(dsp->num_tracks);
+	dsp->voices = std::vector<track_voice>(num_voices);
+	dsp->worker_jobs.resize(num_voices);
+	dsp->serial_jobs.resize(num_voices);
+	dsp->mix_list.resize(num_voices);
+
+	// the voices in the order they are rendered, then the reverb and the delay
+	const size_t reverb_memory = dsp->reverb_type == RB_FLOAT
+									 ? float_reverb_memory(PLAITS_BLOCKSIZE)
+									 : arena_round(kReverbBufferSize * sizeof(uint16_t));
+	const size_t effects_memory = reverb_memory + float_delay_memory(rate);
+	if (!arena_init(dsp->memory, num_voices * track_voice_memory() + effects_memory))
+		return false;
+
+	for (auto& v : dsp->voices)
+		if (!track_voice_init(v, dsp->memory)) return false;
+	for (int i = 0; i < dsp->num_tracks; i++) {
+		dsp->tracks[i].voices = &dsp->voices[i * dsp->voices_per_track];
+		dsp->tracks[i].num_voices = dsp->voices_per_track;
+	}
 
 	trnr::audio_buffer_init(dsp->reverb_buffer, 2, PLAITS_BLOCKSIZE);
+	trnr::audio_buffer_init(dsp->delay_buffer, 1, PLAITS_BLOCKSIZE);
 	trnr::audio_buffer_init(dsp->mix_buffer, 2, PLAITS_BLOCKSIZE);
-	clouds_reverb_init(dsp->reverb, reverb_buffer);
+	if (dsp->reverb_type == RB_FLOAT) {
+		if (!float_reverb_init(dsp->reverb_float, PLAITS_BLOCKSIZE, rate, dsp->memory))
+			return false;
+	} else {
+		auto* buffer = arena_new<uint16_t>(dsp->memory, kReverbBufferSize);
+		if (!buffer) return false;
+		clouds_reverb_init(dsp->reverb, buffer, rate);
+	}
+	if (!float_delay_init(dsp->delay, rate, dsp->memory)) return false;
+
+	if (dsp->num_workers > 0)
+		worker_pool_start(dsp->workers, dsp->num_workers, voice_render_job, dsp.get(),
+						  dsp->worker_cpus, dsp->realtime);
+	return true;
+}
+
+flechtbox_dsp::~flechtbox_dsp()
+{
+	// the workers render out of the arena, they go first
+	worker_pool_stop(workers);
+	for (auto& v : voices)
+		if (v.voice) v.voice->~Voice();
+	arena_free(memory);
+}
+
+size_t track_voice_memory()
+{
+	return arena_round(sizeof(plaits::Voice)) +
+		   arena_round(sizeof(plaits::Voice::Frame) * PLAITS_BLOCKSIZE) +
+		   arena_round(kVoiceBufferSize);
 }
 
-void flechtbox_track_init(flechtbox_track& p)
+bool track_voice_init(track_voice& p, arena& memory)
 {
-	p.frames = new plaits::Voice::Frame[16];
-	p.voice = new plaits::Voice();
-	p.shared_buffer = new char[PLAITS_BLOCKSIZE * 1024];
+	p.voice = arena_new<plaits::Voice>(memory);
+	p.frames = arena_new<plaits::Voice::Frame>(memory, PLAITS_BLOCKSIZE);
+	p.shared_buffer = static_cast<char*>(arena_alloc(memory, kVoiceBufferSize));
+	if (!p.voice || !p.frames || !p.shared_buffer) return false;
 
-	stmlib::BufferAllocator allocator(p.shared_buffer, PLAITS_BLOCKSIZE * 1024);
+	stmlib::BufferAllocator allocator(p.shared_buffer, kVoiceBufferSize);
 	p.voice->Init(&allocator);
 
 	p.plaits_patch.engine = 8;
@@ -63,120 +241,394 @@ void flechtbox_track_init(flechtbox_track& p)
 	p.plaits_mods.trigger = 0;
 	p.plaits_mods.trigger_patched = true;
 	p.plaits_mods.sustain_level = 0;
+	return true;
+}
 
-	track_seq_init(p.sequencer);
+// every track and sequence gets a stream of its own, see rng.hpp. the engines that
+// draw from stmlib::Random start over as well.
+static void dsp_reseed(flechtbox_dsp& dsp, int seed)
+{
+	rng_seed(dsp.pitch_sequence.rng, seed, 0);
+	rng_seed(dsp.octave_sequence.rng, seed, 1);
+	rng_seed(dsp.velocity_sequence.rng, seed, 2);
+	for (int i = 0; i < dsp.num_tracks; i++) {
+		rng_seed(dsp.tracks[i].rng, seed, 3 + i * 2);
+		rng_seed(dsp.tracks[i].sequencer.rng, seed, 4 + i * 2);
+	}
+	stmlib::Random::Seed(0x21 + seed);
+	dsp.seed = seed;
 }
 
-bool rand_bool(int probability)
+void dsp_apply_commands(flechtbox_dsp& dsp)
 {
-	if (probability < 100) {
-		// Generate a random number from 0 to 99
-		static thread_local std::mt19937 rng(std::random_device {}());
-		std::uniform_int_distribution<int> dist(0, 100);
+	// bounded, so a flood of edits can't stall a sub-block
+	// while a switch waits for the bar, edits go to the queued pattern. only the
+	// global settings reach the playing one as well.
+	parameters* spare = dsp_spare_params(dsp);
+	param_cmd c;
+	for (int i = 0; i < 256 && spsc_queue_pop(dsp.commands, c); i++) {
+		if (c.offset == PARAM_CMD_PATTERN) {
+			dsp.pattern_pending = true;
+		} else if (dsp.pattern_pending) {
+			param_cmd_apply(*spare, c);
+			if (param_offset_is_global(c.offset)) param_cmd_apply(*dsp.params, c);
+		} else {
+			param_cmd_apply(*dsp.params, c);
+		}
+	}
 
-		// Return true if random value is less than the probability
-		return dist(rng) < probability;
-	} else {
-		return true;
+	dsp.clock.tempo = dsp.params->master.tempo;
+	dsp.clock.running = dsp.params->master.running;
+
+	const auto& rv = dsp.params->reverb;
+	dsp.reverb.input_gain_ = rv.input_gain;
+	dsp.reverb.reverb_time_ = rv.time;
+	dsp.reverb.diffusion_ = rv.diffusion;
+	dsp.reverb.lp_ = rv.lp;
+	dsp.reverb_float.input_gain = rv.input_gain;
+	dsp.reverb_float.reverb_time = rv.time;
+	dsp.reverb_float.diffusion = rv.diffusion;
+	dsp.reverb_float.lp = rv.lp;
+
+	const auto& dl = dsp.params->delay;
+	dsp.delay.feedback = dl.feedback;
+	dsp.delay.lp = dl.lp;
+	dsp.delay.level = dl.level;
+	dsp.delay.ping_pong = dl.ping_pong;
+}
+
+// stores v and returns whether that changed it, the audio thread is the only writer
+template <typename T>
+static bool publish(std::atomic<T>& a, T v)
+{
+	if (a.load(std::memory_order_relaxed) == v) return false;
+	a.store(v, std::memory_order_relaxed);
+	return true;
+}
+
+void dsp_publish_display(flechtbox_dsp& dsp)
+{
+	auto& d = dsp.display;
+	bool changed = publish(d.quarter_gate, dsp.clock.quarter_gate);
+
+	changed |= publish(d.pitch_pos, dsp.pitch_sequence.current_pos);
+	changed |= publish(d.octave_pos, dsp.octave_sequence.current_pos);
+	changed |= publish(d.velocity_pos, dsp.velocity_sequence.current_pos);
+	for (int i = 0; i < dsp.num_tracks; i++)
+		changed |= publish(d.track_pos[i], dsp.tracks[i].sequencer.current_pos);
+
+	changed |= dsp.pattern_pending != d.pattern_pending;
+	d.pattern_pending = dsp.pattern_pending;
+
+	// the load meters and the midi tempo move all the time, they are shown at
+	// kMeterRate while running and once a second when stopped
+	const double rate = dsp.clock.running ? kMeterRate : 1.0;
+	if (dsp.frames_rendered - d.meters_frame >= dsp_synth_rate(dsp) / rate) {
+		d.meters_frame = dsp.frames_rendered;
+		changed = true;
 	}
+
+	if (changed) redraw_signal_raise(d.redraw);
 }
 
-float randf(float amount, float min = -0.5f, float max = 0.5f)
+void dsp_process_tracks(flechtbox_dsp& dsp, const metronome& clock)
 {
-	if (amount > 0.f) {
-		static thread_local std::mt19937 rng(std::random_device {}());
-		std::uniform_real_distribution<float> dist(min, max);
-		return dist(rng) * amount;
-	} else {
-		return 0.f;
+	const auto& clock_state = clock.cur_clock_states;
+	const auto& master = dsp.params->master;
+	track_seq_process_step(dsp.pitch_sequence, master.pitch_sequence, clock_state);
+	track_seq_process_step(dsp.octave_sequence, master.octave_sequence, clock_state);
+	track_seq_process_step(dsp.velocity_sequence, master.velocity_sequence, clock_state);
+
+	int global_pitch = dsp.pitch_sequence.last_value;
+	int global_octave = dsp.octave_sequence.last_value;
+	int global_velocity = dsp.velocity_sequence.last_value;
+
+	// sequencing and triggers stay serial, so the random numbers are drawn in the
+	// same order regardless of how the voices are rendered
+	for (int i = 0; i < dsp.num_tracks; i++) {
+		auto& t = dsp.tracks[i];
+		const auto& p = dsp.params->tracks[i];
+
+		for (int k = 0; k < t.num_voices; k++) t.voices[k].render_ticks = 0;
+
+		auto& note = t.pending;
+		if (note.countdown >= 0) note.countdown--;
+
+		// a note landing mid sub-block fires on the second of two renders, so its
+		// trigger goes in one sub-block later than a note landing on the first sample
+		if (note.countdown == CLOCK_LOOKAHEAD - 1 && note.offset > 0)
+			t.voices[note.voice].plaits_mods.trigger = 1.f;
+
+		int step_probability = track_seq_process_step(t.sequencer, p.sequence, clock_state);
+
+		// TRIGGERED
+		if (!p.muted && rng_chance(t.rng, step_probability)) {
+			trace_instant("trigger", TRACE_AUDIO, "track", i);
+			note.countdown = CLOCK_LOOKAHEAD;
+			note.offset = clock.cur_clock_offsets[p.sequence.division];
+			note.voice = track_pick_voice(t);
+
+			const int step = t.sequencer.current_pos;
+			note.lock.mask = p.locks.mask[step];
+			note.lock.values = p.locks.values[step];
+
+			// drawn whatever the amounts are, so turning one up doesn't change the
+			// draws that follow
+			note.harmonics_rand_val = rng_bipolar(t.rng) * p.harmonics_rand_amt;
+			note.timbre_rand_val = rng_bipolar(t.rng) * p.timbre_rand_amt;
+			note.morph_rand_val = rng_bipolar(t.rng) * p.morph_rand_amt;
+
+			// apply global parameters
+			note.note = p.pitch;
+			if (p.global_pitch_enabled) note.note += global_pitch;
+			if (p.global_octave_enabled) note.note += global_octave;
+			if (p.global_velocity_enabled) note.velocity = global_velocity / 100.f;
+			else note.velocity = 1.f;
+
+			if (note.offset == 0) t.voices[note.voice].plaits_mods.trigger = 1.f;
+		}
+
+		for (int k = 0; k < t.num_voices; k++) {
+			auto& v = t.voices[k];
+
+			// update plaits patch
+			const int engine = v.plaits_patch.engine;
+			patch_apply_settings(v.plaits_patch, p, v.lock, v.harmonics_rand_val,
+								 v.timbre_rand_val, v.morph_rand_val);
+			if (v.plaits_patch.engine != engine)
+				trace_instant("engine", TRACE_AUDIO, "engine", v.plaits_patch.engine);
+
+			// the note lands in this sub-block, together with its trigger
+			v.split = 0;
+			v.previous_velocity = v.current_velocity;
+			const bool pending = note.countdown >= 0 && note.voice == k;
+			if (pending && note.countdown == 0) {
+				v.harmonics_rand_val = note.harmonics_rand_val;
+				v.timbre_rand_val = note.timbre_rand_val;
+				v.morph_rand_val = note.morph_rand_val;
+				v.current_velocity = note.velocity;
+				v.lock = note.lock;
+				v.started = dsp.frames_rendered;
+				// the hangover counts from the note, whose start may be too quiet or too
+				// short in this sub-block to pass SILENCE_THRESHOLD
+				v.silent_blocks = 0;
+
+				v.split_patch = v.plaits_patch;
+				v.split_patch.note = note.note;
+				patch_apply_settings(v.split_patch, p, v.lock, v.harmonics_rand_val,
+									 v.timbre_rand_val, v.morph_rand_val);
+
+				if (note.offset == 0) {
+					v.plaits_patch = v.split_patch;
+					v.previous_velocity = v.current_velocity;
+				} else {
+					v.split = note.offset;
+				}
+			}
+
+			// a pending note keeps the voice awake, its trigger has to pass the delay
+			v.active = !dsp.skip_silent || pending || v.silent_blocks < SILENCE_HANGOVER;
+		}
+	}
+
+	// render all voices, they are stored track after track
+	if (dsp.workers.threads.empty()) {
+		for (auto& v : dsp.voices)
+			if (v.active) voice_render(v);
+		return;
+	}
+
+	// jobs are indices into dsp.voices
+	int num_jobs = 0;
+	int num_serial = 0;
+	for (int i = 0; i < dsp.num_tracks; i++) {
+		auto& t = dsp.tracks[i];
+		for (int k = 0; k < t.num_voices; k++) {
+			const auto& v = t.voices[k];
+			if (!v.active) continue;
+			const int index = i * dsp.voices_per_track + k;
+			if (voice_uses_shared_rng(v)) dsp.serial_jobs[num_serial++] = index;
+			else dsp.worker_jobs[num_jobs++] = index;
+		}
 	}
+
+	if (num_jobs > 0) worker_pool_fork(dsp.workers, num_jobs);
+
+	for (int i = 0; i < num_serial; i++) voice_render(dsp.voices[dsp.serial_jobs[i]]);
+
+	if (num_jobs > 0) worker_pool_join(dsp.workers, num_jobs);
 }
 
-void dsp_process_block(std::shared_ptr<flechtbox_dsp> dsp, float* out, int block_size)
+void dsp_mix_tracks(flechtbox_dsp& dsp)
+{
+	mix_voice* voices = dsp.mix_list.data();
+	int num_voices = 0;
+
+	for (int t = 0; t < dsp.num_tracks; t++) {
+		const auto& track = dsp.tracks[t];
+		const auto& p = dsp.params->tracks[t];
+
+		for (int k = 0; k < track.num_voices; k++) {
+			const auto& voice = track.voices[k];
+
+			// silent voices contribute nothing, their frames are stale
+			if (!voice.active) continue;
+
+			// the gains include the conversion from 16 bit
+			auto& v = voices[num_voices++];
+			v.frames = voice.frames;
+			v.gain_before = voice.previous_velocity * p.volume / 32768.0f;
+			v.gain_after = voice.current_velocity * p.volume / 32768.0f;
+			v.split = voice.split;
+			v.reverb_send = p.reverb_send_amt;
+			v.delay_send = p.delay_send_amt;
+		}
+	}
+
+	// the voices are mono, both channels get the same signal
+	float** mix = dsp.mix_buffer.channel_ptrs.data();
+	float** reverb = dsp.reverb_buffer.channel_ptrs.data();
+	float* delay = dsp.delay_buffer.channel_ptrs[0];
+	mix_voices(voices, num_voices, mix[0], reverb[0], delay, PLAITS_BLOCKSIZE);
+	std::copy(mix[0], mix[0] + PLAITS_BLOCKSIZE, mix[1]);
+	std::copy(reverb[0], reverb[0] + PLAITS_BLOCKSIZE, reverb[1]);
+}
+
+void dsp_process_effects(flechtbox_dsp& dsp)
 {
-	// if block_size isn't multiple of plaits block size (16), do nothing
-	// TODO: show error
-	if (block_size % PLAITS_BLOCKSIZE != 0) return;
+	float** in_out = dsp.reverb_buffer.channel_ptrs.data();
+	if (dsp.reverb_type == RB_FLOAT)
+		float_reverb_process(dsp.reverb_float, in_out, PLAITS_BLOCKSIZE);
+	else clouds_reverb_process(dsp.reverb, in_out, PLAITS_BLOCKSIZE);
+
+	// the delay adds to the wet reverb, so the output stage sums a single wet bus. its
+	// time follows the clock, which with midi in runs at the tempo of the master.
+	const int division = dsp.params->delay.division;
+	const float beat = 60.f / std::max(dsp.clock.tempo, 1.f);
+	float_delay_set_time(dsp.delay, beat / division_multipliers[division]);
+	float_delay_process(dsp.delay, dsp.delay_buffer.channel_ptrs[0], in_out,
+						PLAITS_BLOCKSIZE);
+}
 
-	// convert from internal block size to whatever size the host is running
-	for (int block_count = 0; block_count < block_size; block_count += PLAITS_BLOCKSIZE) {
-		// clock states for this block
-		auto& clock_state = clock_process_block(dsp->clock, PLAITS_BLOCKSIZE);
+void dsp_write_output(flechtbox_dsp& dsp, float* out)
+{
+	// mix in the effects, soft clip and interleave
+	float** mix = dsp.mix_buffer.channel_ptrs.data();
+	float** reverb = dsp.reverb_buffer.channel_ptrs.data();
+	mix_write_output(mix[0], mix[1], reverb[0], reverb[1], out, PLAITS_BLOCKSIZE);
+}
 
-		track_seq_process_step(dsp->pitch_sequence, clock_state);
-		track_seq_process_step(dsp->octave_sequence, clock_state);
-		track_seq_process_step(dsp->velocity_sequence, clock_state);
+// a midi start plays every sequence from its first step
+static void dsp_rewind_sequences(flechtbox_dsp& dsp)
+{
+	const auto& master = dsp.params->master;
+	track_seq_rewind(dsp.pitch_sequence, master.pitch_sequence);
+	track_seq_rewind(dsp.octave_sequence, master.octave_sequence);
+	track_seq_rewind(dsp.velocity_sequence, master.velocity_sequence);
+	for (int i = 0; i < dsp.num_tracks; i++)
+		track_seq_rewind(dsp.tracks[i].sequencer, dsp.params->tracks[i].sequence);
+}
 
-		int global_pitch = dsp->pitch_sequence.last_value;
-		int global_octave = dsp->octave_sequence.last_value;
-		int global_velocity = dsp->velocity_sequence.last_value;
+// renders one PLAITS_BLOCKSIZE sub-block of interleaved stereo to out
+static void dsp_process_sub_block(flechtbox_dsp& dsp, float* out)
+{
+	trace_scope trace("sub_block", TRACE_AUDIO);
 
-		// render all tracks
-		for (int i = 0; i < NUM_TRACKS; i++) {
-			auto& t = dsp->tracks[i];
+	dsp_apply_commands(dsp);
 
-			if (!t.enabled) continue;
+	// the clock runs CLOCK_LOOKAHEAD sub-blocks ahead, see dsp.hpp
+	const uint64_t clock_frame = dsp.frames_rendered + CLOCK_LOOKAHEAD * PLAITS_BLOCKSIZE;
+	if (midi_sync_sub_block(dsp.midi, dsp.clock, clock_frame, PLAITS_BLOCKSIZE))
+		dsp_rewind_sequences(dsp);
 
-			int step_probability = track_seq_process_step(t.sequencer, clock_state);
+	const int seed = dsp.params->master.seed;
+	if ((dsp.clock.running && !dsp.was_running) || seed != dsp.seed) dsp_reseed(dsp, seed);
+	dsp.was_running = dsp.clock.running;
 
-			// TRIGGERED
-			if (!t.muted && rand_bool(step_probability)) {
+	clock_process_block(dsp.clock, PLAITS_BLOCKSIZE);
 
-				// generate random numbers
-				t.harmonics_rand_val = randf(t.harmonics_rand_amt);
-				t.timbre_rand_val = randf(t.timbre_rand_amt);
-				t.morph_rand_val = randf(t.morph_rand_amt);
+	// a queued pattern takes over on the first step of a bar, or right away when
+	// stopped. the ui filled the spare buffer already, so this is a pointer swap.
+	const bool bar = dsp.clock.cur_clock_states[CL_WHOLE];
+	if (dsp.pattern_pending && (bar || !dsp.clock.running)) {
+		dsp.params = dsp_spare_params(dsp);
+		dsp.pattern_pending = false;
+		dsp.pattern_busy.store(false, std::memory_order_release);
+		trace_instant("pattern", TRACE_AUDIO);
+	}
 
-				// apply global parameters
-				t.plaits_patch.note = t.pitch;
-				if (t.global_pitch_enabled) t.plaits_patch.note += global_pitch;
-				if (t.global_octave_enabled) t.plaits_patch.note += global_octave;
-				if (t.global_velocity_enabled)
-					t.current_velocity = global_velocity / 100.f;
-				else t.current_velocity = 1.f;
-				t.plaits_mods.trigger = 1.f;
-			}
+	const uint64_t start = profile_ticks();
+	dsp_process_tracks(dsp, dsp.clock);
+	const uint64_t tracks_done = profile_ticks();
 
-			// update plaits patch
-			t.plaits_patch.harmonics = t.harmonics + t.harmonics_rand_val;
-			t.plaits_patch.timbre = t.timbre + t.timbre_rand_val;
-			t.plaits_patch.morph = t.morph + t.morph_rand_val;
+	// print voices to output
+	dsp_mix_tracks(dsp);
+	const uint64_t mix_done = profile_ticks();
 
-			t.voice->Render(t.plaits_patch, t.plaits_mods, t.frames, PLAITS_BLOCKSIZE);
+	dsp_process_effects(dsp);
+	const uint64_t effects_done = profile_ticks();
 
-			t.plaits_mods.trigger = 0.f;
-		}
+	dsp_write_output(dsp, out);
+	const uint64_t output_done = profile_ticks();
 
-		// print voices to output
-		for (int i = 0; i < PLAITS_BLOCKSIZE; i++) {
-			float mix_send = 0.f;
-			float reverb_send = 0.f;
-			for (int t = 0; t < NUM_TRACKS; t++) {
-				auto& track = dsp->tracks[t];
-				float voice_out = track.frames[i].out / 32768.0f *
-								  track.current_velocity * track.volume;
-
-				mix_send += voice_out;
-				reverb_send += voice_out * track.reverb_send_amt;
-			}
-			dsp->reverb_buffer.channel_ptrs[0][i] = reverb_send;
-			dsp->reverb_buffer.channel_ptrs[1][i] = reverb_send;
+	std::array<uint64_t, MAX_TRACKS> track_ticks;
+	for (int i = 0; i < dsp.num_tracks; i++) {
+		const auto& t = dsp.tracks[i];
+		track_ticks[i] = 0;
+		for (int k = 0; k < t.num_voices; k++) track_ticks[i] += t.voices[k].render_ticks;
+	}
+	const uint64_t stage_ticks[PROFILE_NUM_STAGES] = {
+		tracks_done - start, mix_done - tracks_done, effects_done - mix_done,
+		output_done - effects_done};
+	profiler_add_sub_block(dsp.profile, track_ticks.data(), dsp.num_tracks, stage_ticks);
 
-			dsp->mix_buffer.channel_ptrs[0][i] = mix_send;
-			dsp->mix_buffer.channel_ptrs[1][i] = mix_send;
-		}
+	dsp.frames_rendered += PLAITS_BLOCKSIZE;
+}
+
+// feeds the resampler
+static void dsp_fill_resampler(void* ctx, float* out, int frames)
+{
+	(void)frames; // always PLAITS_BLOCKSIZE
+	dsp_process_sub_block(*static_cast<flechtbox_dsp*>(ctx), out);
+}
+
+void dsp_process_block(std::shared_ptr<flechtbox_dsp> dsp, float* out, int block_size)
+{
+	rt_section rt;
 
-		clouds_reverb_process(dsp->reverb, dsp->reverb_buffer.channel_ptrs,
-							  PLAITS_BLOCKSIZE);
+	if (dsp->resample) {
+		resampler_process(dsp->output_resampler, out, block_size, dsp_fill_resampler,
+						  dsp.get());
+		dsp_publish_display(*dsp);
+		return;
+	}
 
-		for (int i = 0; i < PLAITS_BLOCKSIZE; i++) {
-			// print reverb signal to mix buffer
-			dsp->mix_buffer.channel_ptrs[0][i] += dsp->reverb_buffer.channel_ptrs[0][i];
-			dsp->mix_buffer.channel_ptrs[1][i] += dsp->reverb_buffer.channel_ptrs[1][i];
+	auto& fifo = dsp->fifo;
+	int remaining = block_size;
+
+	// convert from internal block size to whatever size the host is running. first
+	// what is left of the last sub-block, then whole sub-blocks straight into the host
+	// buffer, and a last one into the fifo if the host size isn't a multiple of 16.
+	while (remaining > 0) {
+		if (dsp->fifo_pos == PLAITS_BLOCKSIZE && remaining >= PLAITS_BLOCKSIZE) {
+			dsp_process_sub_block(*dsp, out);
+			out += PLAITS_BLOCKSIZE * 2;
+			remaining -= PLAITS_BLOCKSIZE;
+			continue;
+		}
 
-			// soft clip mix and write to output
-			*out++ = soft_clip(dsp->mix_buffer.channel_ptrs[0][i]); /* left */
-			*out++ = soft_clip(dsp->mix_buffer.channel_ptrs[1][i]); /* right */
+		if (dsp->fifo_pos == PLAITS_BLOCKSIZE) {
+			dsp_process_sub_block(*dsp, fifo.data());
+			dsp->fifo_pos = 0;
 		}
+
+		const int n = std::min(remaining, PLAITS_BLOCKSIZE - dsp->fifo_pos);
+		std::copy(fifo.begin() + dsp->fifo_pos * 2, fifo.begin() + (dsp->fifo_pos + n) * 2,
+				  out);
+		dsp->fifo_pos += n;
+		out += n * 2;
+		remaining -= n;
 	}
+
+	dsp_publish_display(*dsp);
 }
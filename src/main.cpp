@@ -1,9 +1,24 @@
 #include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <ftxui/component/screen_interactive.hpp>
 #include <memory>
+#include <string>
 #include <thread>
+#include <unistd.h>
+#include <vector>
 
 #include "audio.hpp"
+#ifdef FLECHTBOX_ALSA
+#include "midi_alsa.hpp"
+#endif
+#include "project.hpp"
+#include "render.hpp"
+#include "rt_thread.hpp"
+#include "rtcheck.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 #include "ui.hpp"
 
 ftxui::ScreenInteractive *screen_ptr = nullptr;
@@ -18,19 +33,210 @@ void sig_int_handler(int) {
   }
 }
 
-int main() {
+void print_usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [--render out.wav [--bars N]] [--tracks N] [--voices N] "
+          "[--threads N] [--cpus 2,3,...] [--reverb 12bit|float] [--buffer N] "
+          "[--samplerate N [--resample]] [--stats] [--trace out.json] "
+          "[--project file] [--midi-clock in|out] [--rt [--audio-cpu N]] "
+          "[--fps N]\n",
+          name);
+}
+
+// parses a comma separated list of cpu indices
+std::vector<int> parse_cpu_list(const char *list) {
+  std::vector<int> cpus;
+  for (const char *p = list; *p;) {
+    char *end;
+    long cpu = strtol(p, &end, 10);
+    if (end == p) break;
+    cpus.push_back((int)cpu);
+    p = (*end == ',') ? end + 1 : end;
+  }
+  return cpus;
+}
+
+int main(int argc, char **argv) {
+  const char *render_path = nullptr;
+  int render_bars = 4;
+  bool print_stats = false;
+  const char *trace_path = nullptr;
+  const char *project_path = "flechtbox.project";
+  bool load_project = false;
+  bool realtime = false;
+  rt_thread_options audio_rt;
+  int fps = 30;
+
+  rt_check_init();
+
   dsp = std::make_shared<flechtbox_dsp>();
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--render") && i + 1 < argc) {
+      render_path = argv[++i];
+    } else if (!strcmp(argv[i], "--bars") && i + 1 < argc) {
+      render_bars = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      dsp->num_workers = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--tracks") && i + 1 < argc) {
+      dsp->num_tracks = atoi(argv[++i]);
+      if (dsp->num_tracks < 1 || dsp->num_tracks > MAX_TRACKS) {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--voices") && i + 1 < argc) {
+      dsp->voices_per_track = atoi(argv[++i]);
+      if (dsp->voices_per_track < 1 || dsp->voices_per_track > MAX_VOICES) {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--cpus") && i + 1 < argc) {
+      dsp->worker_cpus = parse_cpu_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--fps") && i + 1 < argc) {
+      fps = atoi(argv[++i]);
+      if (fps < 1) {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--rt")) {
+      realtime = true;
+      dsp->realtime = true;
+    } else if (!strcmp(argv[i], "--audio-cpu") && i + 1 < argc) {
+      audio_rt.cpu = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--project") && i + 1 < argc) {
+      project_path = argv[++i];
+      load_project = true;
+    } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (!strcmp(argv[i], "--stats")) {
+      print_stats = true;
+    } else if (!strcmp(argv[i], "--buffer") && i + 1 < argc) {
+      dsp->buffer_size = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--samplerate") && i + 1 < argc) {
+      dsp->samplerate = atof(argv[++i]);
+      if (dsp->samplerate <= 0) {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--resample")) {
+      dsp->resample = true;
+    } else if (!strcmp(argv[i], "--midi-clock") && i + 1 < argc) {
+      const char *mode = argv[++i];
+      if (!strcmp(mode, "in")) {
+        dsp->midi.mode = MIDI_SYNC_IN;
+      } else if (!strcmp(mode, "out")) {
+        dsp->midi.mode = MIDI_SYNC_OUT;
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--reverb") && i + 1 < argc) {
+      const char *type = argv[++i];
+      if (!strcmp(type, "12bit")) {
+        dsp->reverb_type = RB_CLOUDS_12BIT;
+      } else if (!strcmp(type, "float")) {
+        dsp->reverb_type = RB_FLOAT;
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  // before any thread starts, the ui takes its copy of the parameters from here
+  if (!dsp_init(dsp)) {
+    fprintf(stderr, "could not map the memory for the voices\n");
+    return 1;
+  }
+
+  // a project that doesn't exist yet is created by the first save
+  if (load_project && access(project_path, F_OK) == 0) {
+    if (const char *error = project_load(*dsp->params, project_path)) {
+      fprintf(stderr, "%s: %s\n", project_path, error);
+      return 1;
+    }
+  }
+
+  if (trace_path && !trace_start(trace_path)) {
+    return 1;
+  }
+
+  // each step on its own, whatever the permissions allow
+  if (realtime) {
+    audio_rt.priority = RT_AUDIO_PRIORITY;
+    audio_rt.flush_denormals = true;
+
+    bool future = false;
+    const bool locked = rt_lock_memory(future);
+    fprintf(stderr, "memory: lock %s%s\n", locked ? "ok" : "failed",
+            future ? ", also future allocations" : "");
+  }
+
+  // headless mode, no audio device and no ui
+  if (render_path) {
+    if (realtime) {
+      const rt_thread_result r = rt_thread_setup(audio_rt);
+      rt_thread_print("render thread", audio_rt, r, stderr);
+    }
+    const int result = render_run(dsp, render_path, render_bars);
+    trace_stop();
+    if (print_stats) {
+      stats_print(dsp->stats, stdout);
+      arena_print(dsp->memory, stdout);
+    }
+    return result;
+  }
+
+  // the clock follows the callback times, there is none to follow when rendering
+  if (dsp->midi.mode != MIDI_SYNC_OFF) {
+#ifdef FLECHTBOX_ALSA
+    if (!midi_alsa_start(dsp->midi)) return 1;
+#else
+    fprintf(stderr, "midi clock needs alsa, this build has none\n");
+    return 1;
+#endif
+  }
+
   auto screen = ftxui::ScreenInteractive::Fullscreen();
   screen_ptr = &screen;
 
   std::signal(SIGINT, sig_int_handler);
 
-  // create audio thread
-  std::thread audio_thread(audio_run, dsp);
+  // create audio thread, its setup is reported before the ui takes the terminal
+  std::promise<rt_thread_result> audio_setup;
+  auto audio_result = audio_setup.get_future();
+  std::thread audio_thread(audio_run, dsp, audio_rt, std::move(audio_setup));
+  const rt_thread_result audio_rt_result = audio_result.get();
+  if (realtime || audio_rt.cpu >= 0)
+    rt_thread_print("audio thread", audio_rt, audio_rt_result, stderr);
+
+  // the ui keeps off the cores the audio was given
+  std::vector<int> audio_cpus = dsp->worker_cpus;
+  if (audio_rt.cpu >= 0) audio_cpus.push_back(audio_rt.cpu);
+  if (!audio_cpus.empty() && !rt_thread_avoid(audio_cpus))
+    fprintf(stderr, "ui thread: could not move off the audio cores\n");
 
   // run ui on main thread
-  ui_run(*screen_ptr, dsp);
+  ui_run(*screen_ptr, dsp, project_path, fps);
 
   audio_thread.join();
+#ifdef FLECHTBOX_ALSA
+  midi_alsa_stop();
+#endif
+  trace_stop();
+
+  if (print_stats) {
+    stats_print(dsp->stats, stdout);
+    arena_print(dsp->memory, stdout);
+    midi_sync_print(dsp->midi, stdout);
+  }
+
+  if (rt_check_violations() > 0) {
+    fprintf(stderr, "%ld real-time violations\n", rt_check_violations());
+    return 1;
+  }
   return 0;
 }
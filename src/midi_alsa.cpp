@@ -0,0 +1,142 @@
+#include <alsa/asoundlib.h>
+#include <atomic>
+#include <cstdio>
+#include <poll.h>
+#include <thread>
+#include <vector>
+
+#include "midi_alsa.hpp"
+#include "stats.hpp"
+
+static snd_seq_t* seq = nullptr;
+static int port = -1;
+static int queue = -1;
+// stats_now() when the queue's real time was zero, the queue runs on CLOCK_MONOTONIC
+// just like stats_now()
+static uint64_t queue_origin = 0;
+
+static std::thread thread;
+static std::atomic<bool> quit {false};
+
+static void receive(midi_sync& m)
+{
+	snd_seq_event_t* ev;
+	while (snd_seq_event_input(seq, &ev) >= 0) {
+		midi_realtime type;
+		switch (ev->type) {
+		case SND_SEQ_EVENT_CLOCK: type = MIDI_CLOCK; break;
+		case SND_SEQ_EVENT_START: type = MIDI_START; break;
+		case SND_SEQ_EVENT_CONTINUE: type = MIDI_CONTINUE; break;
+		case SND_SEQ_EVENT_STOP: type = MIDI_STOP; break;
+		default: continue;
+		}
+
+		// stamped by the kernel when the event arrived
+		const snd_seq_real_time_t& t = ev->time.time;
+		const midi_event e {queue_origin + t.tv_sec * 1000000000ull + t.tv_nsec, type};
+		if (!spsc_queue_push(m.in, e)) m.dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+static void send(midi_sync& m)
+{
+	midi_event e;
+	bool sent = false;
+	while (spsc_queue_pop(m.out, e)) {
+		snd_seq_event_t ev;
+		snd_seq_ev_clear(&ev);
+		switch (e.type) {
+		case MIDI_CLOCK: ev.type = SND_SEQ_EVENT_CLOCK; break;
+		case MIDI_START: ev.type = SND_SEQ_EVENT_START; break;
+		case MIDI_CONTINUE: ev.type = SND_SEQ_EVENT_CONTINUE; break;
+		case MIDI_STOP: ev.type = SND_SEQ_EVENT_STOP; break;
+		}
+		snd_seq_ev_set_source(&ev, port);
+		snd_seq_ev_set_subs(&ev);
+
+		// the time the tick reaches the dac, the queue sends events in the past at once
+		const uint64_t t = e.time > queue_origin ? e.time - queue_origin : 0;
+		snd_seq_real_time_t rt;
+		rt.tv_sec = (unsigned int)(t / 1000000000ull);
+		rt.tv_nsec = (unsigned int)(t % 1000000000ull);
+		snd_seq_ev_schedule_real(&ev, queue, 0, &rt);
+
+		snd_seq_event_output(seq, &ev);
+		sent = true;
+	}
+	if (sent) snd_seq_drain_output(seq);
+}
+
+bool midi_alsa_start(midi_sync& m)
+{
+	if (snd_seq_open(&seq, "default", SND_SEQ_OPEN_DUPLEX, SND_SEQ_NONBLOCK) < 0) {
+		fprintf(stderr, "midi: could not open the alsa sequencer\n");
+		seq = nullptr;
+		return false;
+	}
+	snd_seq_set_client_name(seq, "flechtbox");
+
+	const bool in = m.mode == MIDI_SYNC_IN;
+	const unsigned int caps = in ? SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE
+								 : SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ;
+	port = snd_seq_create_simple_port(seq, "clock", caps,
+									  SND_SEQ_PORT_TYPE_MIDI_GENERIC |
+										  SND_SEQ_PORT_TYPE_APPLICATION);
+	queue = snd_seq_alloc_named_queue(seq, "flechtbox clock");
+	if (port < 0 || queue < 0) {
+		fprintf(stderr, "midi: could not create the port\n");
+		snd_seq_close(seq);
+		seq = nullptr;
+		return false;
+	}
+
+	// incoming events are stamped with the queue's real time on arrival
+	if (in) {
+		snd_seq_port_info_t* info;
+		snd_seq_port_info_alloca(&info);
+		snd_seq_get_port_info(seq, port, info);
+		snd_seq_port_info_set_timestamping(info, 1);
+		snd_seq_port_info_set_timestamp_real(info, 1);
+		snd_seq_port_info_set_timestamp_queue(info, queue);
+		snd_seq_set_port_info(seq, port, info);
+	}
+
+	snd_seq_start_queue(seq, queue, nullptr);
+	snd_seq_drain_output(seq);
+	snd_seq_sync_output_queue(seq);
+
+	snd_seq_queue_status_t* status;
+	snd_seq_queue_status_alloca(&status);
+	snd_seq_get_queue_status(seq, queue, status);
+	const uint64_t now = stats_now();
+	const snd_seq_real_time_t* t = snd_seq_queue_status_get_real_time(status);
+	queue_origin = now - (t->tv_sec * 1000000000ull + t->tv_nsec);
+
+	quit = false;
+	thread = std::thread([&m, in] {
+		std::vector<pollfd> fds(snd_seq_poll_descriptors_count(seq, POLLIN));
+		snd_seq_poll_descriptors(seq, fds.data(), fds.size(), POLLIN);
+
+		// the audio thread schedules its ticks a buffer ahead, a millisecond is soon
+		// enough to pass them on
+		while (!quit.load(std::memory_order_relaxed)) {
+			poll(fds.data(), fds.size(), 1);
+			if (in) receive(m);
+			else send(m);
+		}
+	});
+	return true;
+}
+
+void midi_alsa_stop()
+{
+	if (!seq) return;
+
+	quit = true;
+	thread.join();
+
+	// hand over what the thread scheduled last
+	snd_seq_drain_output(seq);
+	snd_seq_close(seq);
+	seq = nullptr;
+}
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cmath>
+
+#include "midi_sync.hpp"
+
+// loop bandwidths. narrower ones smooth out more jitter but take longer to follow a
+// tempo change, at 0.5 Hz the tick loop settles within a few seconds.
+static const double kAudioBandwidth = 0.5;
+static const double kTickBandwidth = 0.5;
+
+// a master that sent no tick for this long stopped its clock, the next tick starts
+// the dll over
+static const double kTickTimeout = 250e6;
+
+// the metronome runs faster or slower by this fraction per quarter note it is off the
+// master, at most by kMaxBend. it catches up within about half a second at 120 bpm.
+static const double kPhaseGain = 1.0;
+static const double kMaxBend = 0.1;
+
+void dll_init(time_dll& d, double time, double period, double bandwidth)
+{
+	d.time = time;
+	d.period = period;
+	d.bandwidth = bandwidth;
+}
+
+double dll_update(time_dll& d, double time, double n)
+{
+	const double predicted = d.time + d.period * n;
+	const double error = time - predicted;
+
+	// loop gains for an update interval of n periods, critically damped
+	const double omega = 2.0 * M_PI * d.bandwidth * d.period * n * 1e-9;
+	d.time = predicted + std::sqrt(2.0) * omega * error;
+	d.period += omega * omega * error / n;
+	return error;
+}
+
+static void jitter_add(midi_jitter& j, double error)
+{
+	const double e = std::abs(error);
+	j.count.store(j.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	j.sum_squares.store(j.sum_squares.load(std::memory_order_relaxed) + e * e,
+						std::memory_order_relaxed);
+	if (e > j.max.load(std::memory_order_relaxed))
+		j.max.store(e, std::memory_order_relaxed);
+}
+
+void midi_jitter_reset(midi_jitter& j)
+{
+	j.count.store(0, std::memory_order_relaxed);
+	j.sum_squares.store(0.0, std::memory_order_relaxed);
+	j.max.store(0.0, std::memory_order_relaxed);
+}
+
+void midi_sync_init(midi_sync& m, double samplerate, double synth_rate)
+{
+	m.frame_ns = 1e9 / samplerate;
+	m.device_per_synth = samplerate / synth_rate;
+	m.synth_rate = synth_rate;
+}
+
+void midi_sync_callback(midi_sync& m, uint64_t dac_time, int frames)
+{
+	if (m.mode == MIDI_SYNC_OFF) return;
+
+	if (m.last_frames == 0) {
+		dll_init(m.audio, (double)dac_time, m.frame_ns, kAudioBandwidth);
+	} else {
+		m.audio_frame += m.last_frames;
+		const double error = dll_update(m.audio, (double)dac_time, m.last_frames);
+
+		// an xrun or a stalled device, the frames no longer match the time
+		if (std::abs(error) > m.last_frames * m.frame_ns)
+			dll_init(m.audio, (double)dac_time, m.frame_ns, kAudioBandwidth);
+	}
+	m.last_frames = frames;
+}
+
+// the time a synth frame reaches the dac
+static double frame_time(const midi_sync& m, double frame)
+{
+	return m.audio.time + (frame * m.device_per_synth - m.audio_frame) * m.audio.period;
+}
+
+// every division ticks on the first frame of the next block, that is the downbeat
+static void clock_rewind(metronome& clock)
+{
+	clock.phases.fill(1.0);
+}
+
+static bool follow(midi_sync& m, metronome& clock, double now, int frames)
+{
+	bool rewind = false;
+
+	midi_event e;
+	while (spsc_queue_pop(m.in, e)) {
+		const double t = (double)e.time;
+
+		switch (e.type) {
+		case MIDI_START:
+		case MIDI_CONTINUE:
+			m.waiting = true;
+			m.rewind = e.type == MIDI_START;
+			m.running = false;
+			break;
+		case MIDI_STOP:
+			m.waiting = false;
+			m.running = false;
+			break;
+		case MIDI_CLOCK:
+			if (m.last_tick == 0 || t - m.last_tick > kTickTimeout) {
+				m.ticks_locked = false;
+			} else if (!m.ticks_locked) {
+				dll_init(m.ticks, t, t - m.last_tick, kTickBandwidth);
+				m.ticks_locked = true;
+			} else {
+				jitter_add(m.input_jitter, dll_update(m.ticks, t, 1.0));
+			}
+			m.last_tick = e.time;
+
+			if (m.waiting) {
+				// the first tick after a start is the downbeat, after a continue it is
+				// wherever the metronome stopped
+				m.waiting = false;
+				m.running = true;
+				if (m.rewind) {
+					m.beats = 0.0;
+					clock_rewind(clock);
+					rewind = true;
+				}
+				m.tick = m.beats * MIDI_PPQ;
+			} else if (m.running) {
+				m.tick += 1.0;
+
+				// where the metronome was when the tick came in, in ticks
+				const double ticks = m.beats * MIDI_PPQ - (now - t) / m.ticks.period;
+				if (m.ticks_locked)
+					jitter_add(m.clock_offset, (ticks - m.tick) * m.ticks.period);
+			}
+			break;
+		}
+	}
+
+	clock.running = m.running;
+
+	// until two ticks came in the metronome keeps its own tempo
+	if (m.ticks_locked) {
+		const double tempo = 60e9 / (MIDI_PPQ * m.ticks.period);
+		m.tempo.store((float)tempo, std::memory_order_relaxed);
+
+		// steer towards the position the master will be at when this block is heard
+		double bend = 0.0;
+		if (m.running) {
+			const double master =
+				(m.tick + (now - m.ticks.time) / m.ticks.period) / MIDI_PPQ;
+			bend = std::clamp((master - m.beats) * kPhaseGain, -kMaxBend, kMaxBend);
+		}
+		clock.tempo = (float)(tempo * (1.0 + bend));
+	}
+
+	if (m.running) m.beats += clock.tempo / 60.0 * frames / m.synth_rate;
+	return rewind;
+}
+
+static void send(midi_sync& m, midi_realtime type, double time)
+{
+	if (spsc_queue_push(m.out, {(uint64_t)std::max(time, 0.0), type}))
+		m.sent.fetch_add(1, std::memory_order_relaxed);
+	else
+		m.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+static bool lead(midi_sync& m, metronome& clock, uint64_t clock_frame, int frames)
+{
+	bool rewind = false;
+	m.tempo.store(clock.tempo, std::memory_order_relaxed);
+
+	// slaves start from their top, so we do as well
+	if (clock.running && !m.running) {
+		m.running = true;
+		m.beats = 0.0;
+		clock_rewind(clock);
+		rewind = true;
+		send(m, MIDI_START, frame_time(m, (double)clock_frame));
+	} else if (!clock.running && m.running) {
+		m.running = false;
+		send(m, MIDI_STOP, frame_time(m, (double)clock_frame));
+	}
+	if (!m.running) return rewind;
+
+	// the ticks in this block, to the frame
+	const double step = clock.tempo / 60.0 * frames / m.synth_rate;
+	for (double tick = std::ceil(m.beats * MIDI_PPQ); tick < (m.beats + step) * MIDI_PPQ;
+		 tick += 1.0) {
+		const double offset = (tick / MIDI_PPQ - m.beats) / step * frames;
+		send(m, MIDI_CLOCK, frame_time(m, clock_frame + offset));
+	}
+	m.beats += step;
+	return rewind;
+}
+
+bool midi_sync_sub_block(midi_sync& m, metronome& clock, uint64_t clock_frame,
+						 int frames)
+{
+	// nothing to go by before the first callback
+	if (m.mode == MIDI_SYNC_OFF || m.last_frames == 0) return false;
+
+	if (m.mode == MIDI_SYNC_IN)
+		return follow(m, clock, frame_time(m, (double)clock_frame), frames);
+	return lead(m, clock, clock_frame, frames);
+}
+
+static void print_jitter(FILE* f, const char* label, const midi_jitter& j)
+{
+	const uint64_t n = j.count.load(std::memory_order_relaxed);
+	if (n == 0) {
+		fprintf(f, "%s no ticks\n", label);
+		return;
+	}
+	const double rms = std::sqrt(j.sum_squares.load(std::memory_order_relaxed) / n);
+	fprintf(f, "%s rms %.3f ms, max %.3f ms over %llu ticks\n", label, rms / 1e6,
+			j.max.load(std::memory_order_relaxed) / 1e6, (unsigned long long)n);
+}
+
+void midi_sync_print(const midi_sync& m, FILE* f)
+{
+	if (m.mode == MIDI_SYNC_OFF) return;
+
+	fprintf(f, "midi clock:     %s, %.2f bpm\n", m.mode == MIDI_SYNC_IN ? "in" : "out",
+			m.tempo.load(std::memory_order_relaxed));
+	if (m.mode == MIDI_SYNC_IN) {
+		print_jitter(f, "input jitter:  ", m.input_jitter);
+		print_jitter(f, "clock offset:  ", m.clock_offset);
+	} else {
+		fprintf(f, "sent:           %llu\n",
+				(unsigned long long)m.sent.load(std::memory_order_relaxed));
+	}
+	fprintf(f, "dropped:        %llu\n",
+			(unsigned long long)m.dropped.load(std::memory_order_relaxed));
+}
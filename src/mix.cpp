@@ -0,0 +1,248 @@
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIX_X86 1
+#endif
+
+#include "mix.hpp"
+
+// every version does the same float operations in the same order, so they all produce
+// bit identical output
+
+// the curve reaches exactly +-1 at +-3, so clamping the input there instead of
+// branching on it gives the same result
+static inline float soft_clip_clamped(float x)
+{
+	x = std::min(std::max(x, -3.f), 3.f);
+	return x * (27.f + x * x) / (27.f + 9.f * x * x);
+}
+
+static void mix_voices_scalar(const mix_voice* voices, int num_voices, float* dry,
+							  float* reverb, float* delay, int frames)
+{
+	std::fill(dry, dry + frames, 0.f);
+	std::fill(reverb, reverb + frames, 0.f);
+	std::fill(delay, delay + frames, 0.f);
+
+	for (int v = 0; v < num_voices; v++) {
+		const mix_voice& m = voices[v];
+		for (int i = 0; i < frames; i++) {
+			float x = m.frames[i].out * (i < m.split ? m.gain_before : m.gain_after);
+			dry[i] += x;
+			reverb[i] += x * m.reverb_send;
+			delay[i] += x * m.delay_send;
+		}
+	}
+}
+
+static void mix_write_output_scalar(const float* dry_l, const float* dry_r,
+									const float* wet_l, const float* wet_r, float* out,
+									int frames)
+{
+	for (int i = 0; i < frames; i++) {
+		*out++ = soft_clip_clamped(dry_l[i] + wet_l[i]);
+		*out++ = soft_clip_clamped(dry_r[i] + wet_r[i]);
+	}
+}
+
+#ifdef MIX_X86
+
+// frames are {int16 out, int16 aux} pairs, so one 32 bit lane holds one frame. shifting
+// left and back sign extends `out` and drops `aux`.
+__attribute__((target("sse2"))) static inline __m128 load_out_sse2(
+	const plaits::Voice::Frame* f)
+{
+	__m128i v = _mm_loadu_si128((const __m128i*)f);
+	return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+}
+
+__attribute__((target("sse2"))) static void
+mix_voices_sse2(const mix_voice* voices, int num_voices, float* dry, float* reverb,
+				float* delay, int frames)
+{
+	for (int i = 0; i < frames; i += 4) {
+		const __m128 index = _mm_add_ps(_mm_set1_ps((float)i), _mm_setr_ps(0, 1, 2, 3));
+		__m128 d = _mm_setzero_ps();
+		__m128 r = _mm_setzero_ps();
+		__m128 e = _mm_setzero_ps();
+		for (int v = 0; v < num_voices; v++) {
+			const mix_voice& m = voices[v];
+			const __m128 before = _mm_cmplt_ps(index, _mm_set1_ps((float)m.split));
+			const __m128 gain = _mm_or_ps(_mm_and_ps(before, _mm_set1_ps(m.gain_before)),
+										  _mm_andnot_ps(before, _mm_set1_ps(m.gain_after)));
+			const __m128 x = _mm_mul_ps(load_out_sse2(m.frames + i), gain);
+			d = _mm_add_ps(d, x);
+			r = _mm_add_ps(r, _mm_mul_ps(x, _mm_set1_ps(m.reverb_send)));
+			e = _mm_add_ps(e, _mm_mul_ps(x, _mm_set1_ps(m.delay_send)));
+		}
+		_mm_storeu_ps(dry + i, d);
+		_mm_storeu_ps(reverb + i, r);
+		_mm_storeu_ps(delay + i, e);
+	}
+}
+
+__attribute__((target("sse2"))) static inline __m128 soft_clip_sse2(__m128 x)
+{
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-3.f)), _mm_set1_ps(3.f));
+	const __m128 x2 = _mm_mul_ps(x, x);
+	const __m128 num = _mm_mul_ps(x, _mm_add_ps(_mm_set1_ps(27.f), x2));
+	const __m128 den =
+		_mm_add_ps(_mm_set1_ps(27.f), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(9.f), x), x));
+	return _mm_div_ps(num, den);
+}
+
+__attribute__((target("sse2"))) static void
+mix_write_output_sse2(const float* dry_l, const float* dry_r, const float* wet_l,
+					  const float* wet_r, float* out, int frames)
+{
+	for (int i = 0; i < frames; i += 4) {
+		const __m128 l =
+			soft_clip_sse2(_mm_add_ps(_mm_loadu_ps(dry_l + i), _mm_loadu_ps(wet_l + i)));
+		const __m128 r =
+			soft_clip_sse2(_mm_add_ps(_mm_loadu_ps(dry_r + i), _mm_loadu_ps(wet_r + i)));
+		_mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(l, r));
+		_mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(l, r));
+	}
+}
+
+__attribute__((target("avx2"))) static inline __m256 load_out_avx2(
+	const plaits::Voice::Frame* f)
+{
+	__m256i v = _mm256_loadu_si256((const __m256i*)f);
+	return _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16));
+}
+
+__attribute__((target("avx2"))) static void
+mix_voices_avx2(const mix_voice* voices, int num_voices, float* dry, float* reverb,
+				float* delay, int frames)
+{
+	for (int i = 0; i < frames; i += 8) {
+		const __m256 index =
+			_mm256_add_ps(_mm256_set1_ps((float)i), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+		__m256 d = _mm256_setzero_ps();
+		__m256 r = _mm256_setzero_ps();
+		__m256 e = _mm256_setzero_ps();
+		for (int v = 0; v < num_voices; v++) {
+			const mix_voice& m = voices[v];
+			const __m256 before =
+				_mm256_cmp_ps(index, _mm256_set1_ps((float)m.split), _CMP_LT_OQ);
+			const __m256 gain = _mm256_blendv_ps(_mm256_set1_ps(m.gain_after),
+												 _mm256_set1_ps(m.gain_before), before);
+			const __m256 x = _mm256_mul_ps(load_out_avx2(m.frames + i), gain);
+			d = _mm256_add_ps(d, x);
+			r = _mm256_add_ps(r, _mm256_mul_ps(x, _mm256_set1_ps(m.reverb_send)));
+			e = _mm256_add_ps(e, _mm256_mul_ps(x, _mm256_set1_ps(m.delay_send)));
+		}
+		_mm256_storeu_ps(dry + i, d);
+		_mm256_storeu_ps(reverb + i, r);
+		_mm256_storeu_ps(delay + i, e);
+	}
+}
+
+__attribute__((target("avx2"))) static inline __m256 soft_clip_avx2(__m256 x)
+{
+	x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-3.f)), _mm256_set1_ps(3.f));
+	const __m256 x2 = _mm256_mul_ps(x, x);
+	const __m256 num = _mm256_mul_ps(x, _mm256_add_ps(_mm256_set1_ps(27.f), x2));
+	const __m256 den = _mm256_add_ps(_mm256_set1_ps(27.f),
+									 _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(9.f), x), x));
+	return _mm256_div_ps(num, den);
+}
+
+__attribute__((target("avx2"))) static void
+mix_write_output_avx2(const float* dry_l, const float* dry_r, const float* wet_l,
+					  const float* wet_r, float* out, int frames)
+{
+	for (int i = 0; i < frames; i += 8) {
+		const __m256 l = soft_clip_avx2(
+			_mm256_add_ps(_mm256_loadu_ps(dry_l + i), _mm256_loadu_ps(wet_l + i)));
+		const __m256 r = soft_clip_avx2(
+			_mm256_add_ps(_mm256_loadu_ps(dry_r + i), _mm256_loadu_ps(wet_r + i)));
+
+		// unpack works within 128 bit halves, so the halves need reordering after
+		const __m256 lo = _mm256_unpacklo_ps(l, r);
+		const __m256 hi = _mm256_unpackhi_ps(l, r);
+		_mm256_storeu_ps(out + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(out + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+}
+
+#endif
+
+typedef void (*mix_voices_fn)(const mix_voice*, int, float*, float*, float*, int);
+typedef void (*mix_write_output_fn)(const float*, const float*, const float*,
+									const float*, float*, int);
+
+static mix_impl selected = MIX_SCALAR;
+static mix_voices_fn voices_fn = mix_voices_scalar;
+static mix_write_output_fn write_output_fn = mix_write_output_scalar;
+
+static bool mix_supported(mix_impl impl)
+{
+	switch (impl) {
+	case MIX_SCALAR: return true;
+#ifdef MIX_X86
+	case MIX_SSE2: return __builtin_cpu_supports("sse2");
+	case MIX_AVX2: return __builtin_cpu_supports("avx2");
+#endif
+	default: return false;
+	}
+}
+
+bool mix_select(mix_impl impl)
+{
+	if (!mix_supported(impl)) return false;
+
+	switch (impl) {
+#ifdef MIX_X86
+	case MIX_SSE2:
+		voices_fn = mix_voices_sse2;
+		write_output_fn = mix_write_output_sse2;
+		break;
+	case MIX_AVX2:
+		voices_fn = mix_voices_avx2;
+		write_output_fn = mix_write_output_avx2;
+		break;
+#endif
+	default:
+		voices_fn = mix_voices_scalar;
+		write_output_fn = mix_write_output_scalar;
+		break;
+	}
+	selected = impl;
+	return true;
+}
+
+mix_impl mix_selected() { return selected; }
+
+const char* mix_impl_name(mix_impl impl)
+{
+	switch (impl) {
+	case MIX_SCALAR: return "scalar";
+	case MIX_SSE2: return "sse2";
+	case MIX_AVX2: return "avx2";
+	default: return "unknown";
+	}
+}
+
+void mix_init()
+{
+#ifdef MIX_X86
+	__builtin_cpu_init();
+#endif
+	for (int impl = MIX_NUM_IMPLS - 1; impl >= 0; impl--)
+		if (mix_select((mix_impl)impl)) break;
+}
+
+void mix_voices(const mix_voice* voices, int num_voices, float* dry, float* reverb,
+				float* delay, int frames)
+{
+	voices_fn(voices, num_voices, dry, reverb, delay, frames);
+}
+
+void mix_write_output(const float* dry_l, const float* dry_r, const float* wet_l,
+					  const float* wet_r, float* out, int frames)
+{
+	write_output_fn(dry_l, dry_r, wet_l, wet_r, out, frames);
+}
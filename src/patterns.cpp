@@ -0,0 +1,45 @@
+#include <cstring>
+
+#include "patterns.hpp"
+
+void pattern_bank_init(pattern_bank& b, const parameters& p)
+{
+	b.patterns.fill(p);
+	b.current = 0;
+}
+
+void pattern_keep_globals(parameters& to, const parameters& from)
+{
+	// the same words param_offset_is_global names
+	to.master.tempo = from.master.tempo;
+	to.master.running = from.master.running;
+	to.master.scale = from.master.scale;
+	to.reverb = from.reverb;
+	to.delay = from.delay;
+}
+
+bool pattern_queue(pattern_bank& b, int next, parameters& edited, parameters& sent,
+				   flechtbox_dsp& dsp)
+{
+	if (dsp.pattern_busy.load(std::memory_order_acquire)) return false;
+
+	// whatever was changed since the last sync still belongs to the current pattern
+	param_sync(edited, sent, dsp.commands);
+	b.patterns[b.current] = edited;
+
+	parameters next_params = b.patterns[next];
+	pattern_keep_globals(next_params, edited);
+
+	// the audio thread doesn't read the spare buffer until it gets the command below
+	dsp.pattern_busy.store(true, std::memory_order_relaxed);
+	memcpy(dsp_spare_params(dsp), &next_params, sizeof(parameters));
+	if (!spsc_queue_push(dsp.commands, param_cmd {PARAM_CMD_PATTERN, 0})) {
+		dsp.pattern_busy.store(false, std::memory_order_relaxed);
+		return false;
+	}
+
+	memcpy(&edited, &next_params, sizeof(parameters));
+	memcpy(&sent, &next_params, sizeof(parameters));
+	b.current = next;
+	return true;
+}
@@ -0,0 +1,71 @@
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+#include "profiler.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// weight of each sub-block in the averages, about a third of a second at 48 kHz
+static const float kAverageWeight = 0.01f;
+
+uint64_t profile_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+// the time stamp counter runs at a constant rate on everything recent, but that rate
+// has to be measured
+static double measure_ns_per_tick()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	const auto t0 = std::chrono::steady_clock::now();
+	const uint64_t c0 = profile_ticks();
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	const uint64_t c1 = profile_ticks();
+	const auto t1 = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(t1 - t0).count() / (double)(c1 - c0);
+#else
+	return 1.0;
+#endif
+}
+
+void profiler_init(profiler& p, double sub_block_seconds)
+{
+	static const double ns_per_tick = measure_ns_per_tick();
+	p.load_per_tick = ns_per_tick / (sub_block_seconds * 1e9);
+}
+
+void profiler_add_sub_block(profiler& p, const uint64_t* track_ticks, int num_tracks,
+							const uint64_t* stage_ticks)
+{
+	for (int t = 0; t < num_tracks; t++) {
+		const float load = (float)(track_ticks[t] * p.load_per_tick);
+		p.track_avg[t] += (load - p.track_avg[t]) * kAverageWeight;
+		p.track_load[t].store(p.track_avg[t], std::memory_order_relaxed);
+	}
+	for (int s = 0; s < PROFILE_NUM_STAGES; s++) {
+		const float load = (float)(stage_ticks[s] * p.load_per_tick);
+		p.stage_avg[s] += (load - p.stage_avg[s]) * kAverageWeight;
+		p.stage_load[s].store(p.stage_avg[s], std::memory_order_relaxed);
+	}
+}
+
+const char* profile_stage_name(profile_stage stage)
+{
+	switch (stage) {
+	case PROFILE_TRACKS: return "tracks";
+	case PROFILE_MIX: return "mix";
+	case PROFILE_EFFECTS: return "fx";
+	case PROFILE_OUTPUT: return "output";
+	default: return "unknown";
+	}
+}
@@ -0,0 +1,160 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "engines.hpp"
+#include "project.hpp"
+
+// the file is the struct as it is, so its size changing means the format changed
+static_assert(sizeof(parameters) == 11344, "parameters changed, bump PROJECT_VERSION");
+
+static uint32_t fnv1a(const void* data, size_t size)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; i++) hash = (hash ^ p[i]) * 16777619u;
+	return hash;
+}
+
+// a bool read from a file can hold any byte, which is undefined behaviour to use
+static bool valid_bool(const bool& b)
+{
+	unsigned char byte;
+	memcpy(&byte, &b, 1);
+	return byte <= 1;
+}
+
+static bool valid_float(float f, float min, float max)
+{
+	return std::isfinite(f) && f >= min && f <= max;
+}
+
+static const char* validate_seq(const param_seq& s)
+{
+	if (s.length < 1 || s.length > NUM_STEPS) return "sequence length out of range";
+	if (s.playback_dir < PB_FORWARD || s.playback_dir > PB_RANDOM)
+		return "unknown playback direction";
+	if (s.division < CL_WHOLE || s.division >= CL_NUM_CLOCK_DIVISIONS)
+		return "unknown clock division";
+	return nullptr;
+}
+
+const char* project_validate(const parameters& p)
+{
+	const auto& m = p.master;
+	if (!valid_float(m.tempo, 20.f, 250.f)) return "tempo out of range";
+	if (!valid_bool(m.running)) return "damaged flag";
+	if (m.scale != T_MAJOR && m.scale != T_MINOR) return "unknown scale";
+	if (m.seed < 0) return "seed out of range";
+
+	for (auto* s : {&m.pitch_sequence, &m.octave_sequence, &m.velocity_sequence})
+		if (const char* error = validate_seq(*s)) return error;
+
+	for (const auto& t : p.tracks) {
+		if (t.engine < 0 || t.engine >= (int)engine_names.size()) return "unknown engine";
+		for (float f : {t.harmonics, t.harmonics_rand_amt, t.timbre, t.timbre_rand_amt,
+						t.morph, t.morph_rand_amt, t.decay, t.lpg_colour,
+						t.reverb_send_amt, t.delay_send_amt, t.volume})
+			if (!std::isfinite(f)) return "damaged track setting";
+		for (const bool* b : {&t.global_pitch_enabled, &t.global_velocity_enabled,
+							  &t.global_octave_enabled, &t.muted})
+			if (!valid_bool(*b)) return "damaged flag";
+		if (const char* error = validate_seq(t.sequence)) return error;
+
+		for (int s = 0; s < NUM_STEPS; s++) {
+			if (t.locks.mask[s] >> PL_NUM_TARGETS) return "unknown parameter lock";
+			for (float f : t.locks.values[s])
+				if (!std::isfinite(f)) return "damaged parameter lock";
+			const float engine = t.locks.values[s][PL_ENGINE];
+			if ((t.locks.mask[s] >> PL_ENGINE) & 1 &&
+				(engine < 0.f || engine >= (float)engine_names.size()))
+				return "unknown engine";
+		}
+	}
+
+	const auto& r = p.reverb;
+	if (!valid_float(r.input_gain, 0.f, 1.f) || !valid_float(r.time, 0.f, 0.99f) ||
+		!valid_float(r.diffusion, 0.f, 0.99f) || !valid_float(r.lp, 0.f, 1.f))
+		return "reverb setting out of range";
+
+	const auto& d = p.delay;
+	if (d.division < CL_WHOLE || d.division >= CL_NUM_CLOCK_DIVISIONS)
+		return "unknown clock division";
+	if (!valid_float(d.feedback, 0.f, 0.99f) || !valid_float(d.lp, 0.f, 1.f) ||
+		!valid_float(d.level, 0.f, 1.f))
+		return "delay setting out of range";
+	if (!valid_bool(d.ping_pong)) return "damaged flag";
+
+	return nullptr;
+}
+
+const char* project_save(const parameters& p, const char* path)
+{
+	project_header h;
+	h.magic = PROJECT_MAGIC;
+	h.version = PROJECT_VERSION;
+	h.payload_size = sizeof(parameters);
+	h.checksum = fnv1a(&p, sizeof(parameters));
+
+	const std::string tmp = std::string(path) + ".tmp";
+	FILE* f = fopen(tmp.c_str(), "wb");
+	if (!f) return "could not open the file for writing";
+
+	const bool written = fwrite(&h, sizeof(h), 1, f) == 1 &&
+						 fwrite(&p, sizeof(parameters), 1, f) == 1;
+	if (fclose(f) != 0 || !written) {
+		remove(tmp.c_str());
+		return "could not write the file";
+	}
+
+	if (rename(tmp.c_str(), path) != 0) {
+		remove(tmp.c_str());
+		return "could not replace the file";
+	}
+	return nullptr;
+}
+
+const char* project_load(parameters& p, const char* path)
+{
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0) return "could not open the file";
+
+	const size_t size = sizeof(project_header) + sizeof(parameters);
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+		close(fd);
+		return "not a project file of this version";
+	}
+
+	void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return "could not map the file";
+
+	project_header h;
+	memcpy(&h, map, sizeof(h));
+	const char* payload = static_cast<const char*>(map) + sizeof(h);
+
+	const char* error = nullptr;
+	if (h.magic != PROJECT_MAGIC) error = "not a project file";
+	else if (h.version != PROJECT_VERSION || h.payload_size != sizeof(parameters))
+		error = "not a project file of this version";
+	else if (h.checksum != fnv1a(payload, sizeof(parameters))) error = "damaged file";
+
+	// checked on a copy, p stays as it is if anything is wrong
+	parameters loaded;
+	if (!error) {
+		memcpy(&loaded, payload, sizeof(parameters));
+		error = project_validate(loaded);
+	}
+	munmap(map, size);
+	if (error) return error;
+
+	loaded.master.running = p.master.running;
+	memcpy(&p, &loaded, sizeof(parameters));
+	return nullptr;
+}
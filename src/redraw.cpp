@@ -0,0 +1,64 @@
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "redraw.hpp"
+
+// blocks while s.pending is 0. it can return early, callers check again.
+static void pending_wait(redraw_signal& s, std::chrono::microseconds interval)
+{
+#if defined(__linux__)
+	(void)interval;
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&s.pending), FUTEX_WAIT_PRIVATE, 0,
+			nullptr, nullptr, 0);
+#else
+	// no futex, the ui looks again once per frame
+	(void)s;
+	std::this_thread::sleep_for(interval);
+#endif
+}
+
+static void pending_wake(redraw_signal& s)
+{
+#if defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&s.pending), FUTEX_WAKE_PRIVATE, 1,
+			nullptr, nullptr, 0);
+#else
+	(void)s;
+#endif
+}
+
+void redraw_signal_raise(redraw_signal& s)
+{
+	// raised before the look at `waiters`, and the ui registers before its last look at
+	// `pending`, so one of the two sees the other. once raised, the ui isn't asleep.
+	if (s.pending.exchange(1, std::memory_order_seq_cst) != 0) return;
+	if (s.waiters.load(std::memory_order_seq_cst) > 0) pending_wake(s);
+}
+
+bool redraw_signal_wait(redraw_signal& s, std::chrono::microseconds interval)
+{
+	while (s.pending.load(std::memory_order_acquire) == 0) {
+		s.waiters.fetch_add(1, std::memory_order_seq_cst);
+		if (s.pending.load(std::memory_order_seq_cst) == 0) pending_wait(s, interval);
+		s.waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+	std::this_thread::sleep_until(s.last_frame + interval);
+	if (s.closed.load(std::memory_order_acquire)) return false;
+
+	s.pending.store(0, std::memory_order_release);
+	s.last_frame = std::chrono::steady_clock::now();
+	return true;
+}
+
+void redraw_signal_close(redraw_signal& s)
+{
+	// raised as well, so a wait that is just going to sleep doesn't
+	s.closed.store(true, std::memory_order_release);
+	s.pending.store(1, std::memory_order_seq_cst);
+	pending_wake(s);
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "dsp.hpp"
+#include "render.hpp"
+#include "rtcheck.hpp"
+#include "stats.hpp"
+
+static void write_u16(FILE* f, uint16_t v)
+{
+	const uint8_t b[2] = {(uint8_t)(v & 0xff), (uint8_t)(v >> 8)};
+	fwrite(b, 1, 2, f);
+}
+
+static void write_u32(FILE* f, uint32_t v)
+{
+	const uint8_t b[4] = {(uint8_t)(v & 0xff), (uint8_t)((v >> 8) & 0xff),
+						  (uint8_t)((v >> 16) & 0xff), (uint8_t)(v >> 24)};
+	fwrite(b, 1, 4, f);
+}
+
+// canonical 44 byte header for interleaved IEEE float samples (format tag 3)
+static void wav_write_header(FILE* f, int channels, uint32_t samplerate, uint32_t frames)
+{
+	const uint32_t bytes_per_frame = channels * sizeof(float);
+	const uint32_t data_size = frames * bytes_per_frame;
+
+	fwrite("RIFF", 1, 4, f);
+	write_u32(f, 36 + data_size);
+	fwrite("WAVE", 1, 4, f);
+	fwrite("fmt ", 1, 4, f);
+	write_u32(f, 16);
+	write_u16(f, 3);
+	write_u16(f, channels);
+	write_u32(f, samplerate);
+	write_u32(f, samplerate * bytes_per_frame);
+	write_u16(f, bytes_per_frame);
+	write_u16(f, 32);
+	fwrite("data", 1, 4, f);
+	write_u32(f, data_size);
+}
+
+int render_run(std::shared_ptr<flechtbox_dsp> dsp, const char* path, int bars)
+{
+	if (bars < 1) {
+		fprintf(stderr, "render: number of bars must be at least 1\n");
+		return 1;
+	}
+
+	dsp->params->master.running = true;
+
+	// one bar is four quarter notes, rounded up to whole plaits blocks
+	const double bar_seconds = 4.0 * 60.0 / dsp->params->master.tempo;
+	long frames = (long)(bars * bar_seconds * dsp->samplerate);
+	frames = (frames + PLAITS_BLOCKSIZE - 1) / PLAITS_BLOCKSIZE * PLAITS_BLOCKSIZE;
+
+	FILE* f = fopen(path, "wb");
+	if (!f) {
+		fprintf(stderr, "render: could not open %s for writing\n", path);
+		return 1;
+	}
+
+	wav_write_header(f, 2, (uint32_t)dsp->samplerate, (uint32_t)frames);
+
+	std::vector<float> block(BLOCKSIZE * 2);
+	std::chrono::steady_clock::duration dsp_time {0};
+
+	for (long done = 0; done < frames;) {
+		const int n = (int)std::min<long>(BLOCKSIZE, frames - done);
+
+		// only time the dsp, not the file io
+		auto start = std::chrono::steady_clock::now();
+		const uint64_t stats_start = stats_now();
+		dsp_process_block(dsp, block.data(), n);
+		stats_record(dsp->stats, stats_start, n, dsp->samplerate, false, false, -1.0);
+		dsp_time += std::chrono::steady_clock::now() - start;
+
+		fwrite(block.data(), sizeof(float), n * 2, f);
+		done += n;
+	}
+
+	const bool write_failed = ferror(f);
+	fclose(f);
+
+	if (write_failed) {
+		fprintf(stderr, "render: error while writing %s\n", path);
+		return 1;
+	}
+
+	const double audio_seconds = frames / dsp->samplerate;
+	const double dsp_seconds = std::chrono::duration<double>(dsp_time).count();
+
+	printf("rendered %d bars (%.2f s) to %s\n", bars, audio_seconds, path);
+	printf("dsp time: %.3f s, real-time factor: %.1fx\n", dsp_seconds,
+		   dsp_seconds > 0.0 ? audio_seconds / dsp_seconds : 0.0);
+
+	if (rt_check_violations() > 0) {
+		fprintf(stderr, "render: %ld real-time violations\n", rt_check_violations());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "resampler.hpp"
+
+typedef float v4sf __attribute__((vector_size(16)));
+
+// kaiser window with about 80 dB stopband attenuation
+static const double kKaiserBeta = 8.0;
+
+static double bessel_i0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+void resampler_init(resampler& r, double in_rate, double out_rate, int fill_frames)
+{
+	r.ratio = in_rate / out_rate;
+
+	// the stopband starts at the lower of the two nyquist frequencies, the passband ends
+	// one transition width below it. frequencies relative to the input rate.
+	const double half_taps = RESAMPLER_TAPS / 2.0;
+	const double transition = (80.0 - 8.0) / (2.285 * 2.0 * M_PI * RESAMPLER_TAPS);
+	const double stop = 0.5 * std::min(1.0, out_rate / in_rate);
+	const double cutoff = stop - transition / 2.0;
+
+	// output frame at fractional position f sits between taps half_taps - 1 and half_taps
+	r.coeffs.assign((RESAMPLER_PHASES + 1) * RESAMPLER_TAPS, 0.f);
+	for (int p = 0; p <= RESAMPLER_PHASES; p++) {
+		const double frac = (double)p / RESAMPLER_PHASES;
+		float* h = &r.coeffs[p * RESAMPLER_TAPS];
+		double sum = 0.0;
+		for (int t = 0; t < RESAMPLER_TAPS; t++) {
+			const double d = t - (half_taps - 1.0) - frac;
+			const double x = 2.0 * cutoff * d;
+			const double sinc = d == 0.0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+			const double w = d / half_taps;
+			const double window =
+				std::fabs(w) >= 1.0
+					? 0.0
+					: bessel_i0(kKaiserBeta * std::sqrt(1.0 - w * w)) / bessel_i0(kKaiserBeta);
+			h[t] = (float)(sinc * window);
+			sum += h[t];
+		}
+		// unity gain at dc for every phase
+		for (int t = 0; t < RESAMPLER_TAPS; t++) h[t] = (float)(h[t] / sum);
+	}
+
+	// room for a full filter span plus one block, starting with silence so the first
+	// output frame doesn't wait for a whole span of input
+	const int capacity = 2 * RESAMPLER_TAPS + fill_frames;
+	for (auto& h : r.history) h.assign(capacity, 0.f);
+	r.available = RESAMPLER_TAPS - 1;
+	r.pos = 0.0;
+
+	r.fill_frames = fill_frames;
+	r.fill_buffer.assign(fill_frames * 2, 0.f);
+}
+
+static inline v4sf load4(const float* p)
+{
+	v4sf v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline float sum4(v4sf v) { return (v[0] + v[1]) + (v[2] + v[3]); }
+
+static void resampler_pull(resampler& r, resampler_fill_fn fill, void* ctx)
+{
+	// drop what the filter has passed already
+	const int consumed = (int)r.pos;
+	if (r.available + r.fill_frames > (int)r.history[0].size()) {
+		for (auto& h : r.history)
+			std::copy(h.begin() + consumed, h.begin() + r.available, h.begin());
+		r.available -= consumed;
+		r.pos -= consumed;
+	}
+
+	fill(ctx, r.fill_buffer.data(), r.fill_frames);
+	for (int i = 0; i < r.fill_frames; i++) {
+		r.history[0][r.available + i] = r.fill_buffer[i * 2];
+		r.history[1][r.available + i] = r.fill_buffer[i * 2 + 1];
+	}
+	r.available += r.fill_frames;
+}
+
+void resampler_process(resampler& r, float* out, int frames, resampler_fill_fn fill,
+					   void* ctx)
+{
+	for (int n = 0; n < frames; n++) {
+		while ((int)r.pos + RESAMPLER_TAPS > r.available) resampler_pull(r, fill, ctx);
+
+		const int index = (int)r.pos;
+		const double phase = (r.pos - index) * RESAMPLER_PHASES;
+		const int p = (int)phase;
+		const float frac = (float)(phase - p);
+
+		// both neighbouring phases at once, four taps at a time
+		const float* h0 = &r.coeffs[p * RESAMPLER_TAPS];
+		const float* h1 = h0 + RESAMPLER_TAPS;
+		const float* l = &r.history[0][index];
+		const float* rr = &r.history[1][index];
+
+		v4sf l0 = {0, 0, 0, 0}, l1 = l0, r0 = l0, r1 = l0;
+		for (int t = 0; t < RESAMPLER_TAPS; t += 4) {
+			const v4sf a = load4(h0 + t);
+			const v4sf b = load4(h1 + t);
+			const v4sf xl = load4(l + t);
+			const v4sf xr = load4(rr + t);
+			l0 += xl * a;
+			l1 += xl * b;
+			r0 += xr * a;
+			r1 += xr * b;
+		}
+
+		const float left0 = sum4(l0);
+		const float right0 = sum4(r0);
+		*out++ = left0 + (sum4(l1) - left0) * frac;
+		*out++ = right0 + (sum4(r1) - right0) * frac;
+
+		r.pos += r.ratio;
+	}
+}
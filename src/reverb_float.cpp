@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cstring>
+
+#include "reverb_float.hpp"
+
+typedef float v2sf __attribute__((vector_size(8)));
+
+// delay lengths of clouds_reverb. ap1 also carries the smear taps.
+static const uint32_t kApLength[4] = {113, 162, 241, 399};
+static const uint32_t kLoopApALength[2] = {1653, 1913};
+static const uint32_t kLoopApBLength[2] = {2038, 1663};
+static const uint32_t kDel1Length = 3411;
+static const float kDel2Tap = 4680.f;
+static const float kDel2Modulation = 100.f;
+
+// unlike the 12 bit lines, which round a dying tail to zero, float lines would decay
+// into denormals that cost many times more to process. a tiny dc offset at the input
+// keeps every line above that range, it passes the allpasses and the loop unchanged.
+static const float kAntiDenormal = 1e-20f;
+
+static uint32_t line_size(uint32_t length)
+{
+	uint32_t size = 1;
+	while (size < length) size <<= 1;
+	return size;
+}
+
+// the arena hands out zeroed memory
+static bool line_init(float_reverb_line& l, uint32_t length, int lanes, arena& memory)
+{
+	const uint32_t size = line_size(length);
+	l.data = static_cast<float*>(arena_alloc(memory, size * lanes * sizeof(float)));
+	l.mask = size - 1;
+	return l.data != nullptr;
+}
+
+// lengths the loop lines are allocated for, both lanes in one
+static const uint32_t kLoopApALine = std::max(kLoopApALength[0], kLoopApALength[1]);
+static const uint32_t kLoopApBLine = std::max(kLoopApBLength[0], kLoopApBLength[1]);
+static const uint32_t kLoopDelayLine = (uint32_t)(kDel2Tap + kDel2Modulation) + 2;
+
+size_t float_reverb_memory(size_t max_block_size)
+{
+	size_t size = 0;
+	for (int i = 0; i < 4; i++)
+		size += arena_round(line_size(kApLength[i]) * sizeof(float));
+	for (uint32_t length : {kLoopApALine, kLoopApBLine, kLoopDelayLine})
+		size += arena_round(line_size(length) * 2 * sizeof(float));
+	return size + 2 * arena_round(max_block_size * sizeof(float));
+}
+
+static inline float line_read(const float_reverb_line& l, uint32_t w, uint32_t delay)
+{
+	return l.data[(w - delay) & l.mask];
+}
+
+static inline float line_read_lane(const float_reverb_line& l, uint32_t w, uint32_t delay,
+								   int lane)
+{
+	return l.data[((w - delay) & l.mask) * 2 + lane];
+}
+
+static inline float line_interpolate_lane(const float_reverb_line& l, uint32_t w,
+										  float delay, int lane)
+{
+	const uint32_t integral = (uint32_t)delay;
+	const float fractional = delay - integral;
+	const float a = line_read_lane(l, w, integral, lane);
+	const float b = line_read_lane(l, w, integral + 1, lane);
+	return a + (b - a) * fractional;
+}
+
+static inline void line_write_lanes(float_reverb_line& l, uint32_t w, v2sf v)
+{
+	memcpy(&l.data[(w & l.mask) * 2], &v, sizeof(v));
+}
+
+// reads the end of a two lane allpass, where each lane has its own length
+static inline v2sf loop_ap_read(const float_reverb_line& l, uint32_t w,
+								const uint32_t* length)
+{
+	return v2sf {line_read_lane(l, w, length[0] - 1, 0),
+				 line_read_lane(l, w, length[1] - 1, 1)};
+}
+
+bool float_reverb_init(float_reverb& r, size_t max_block_size, float samplerate,
+					   arena& memory)
+{
+	bool ok = true;
+	for (int i = 0; i < 4; i++) ok &= line_init(r.ap[i], kApLength[i], 1, memory);
+	ok &= line_init(r.loop_ap_a, kLoopApALine, 2, memory);
+	ok &= line_init(r.loop_ap_b, kLoopApBLine, 2, memory);
+	ok &= line_init(r.loop_delay, kLoopDelayLine, 2, memory);
+
+	// same rates as clouds_reverb, 0.75 Hz and 0.45 Hz
+	// at any samplerate. they advance once every 32 samples.
+	const float rate_scale = 48000.0f / samplerate * 32.0f;
+	r.lfo[0].Init<stmlib::COSINE_OSCILLATOR_APPROXIMATE>(0.5f / 32000.0f * rate_scale);
+	r.lfo[1].Init<stmlib::COSINE_OSCILLATOR_APPROXIMATE>(0.3f / 32000.0f * rate_scale);
+
+	const size_t block_bytes = max_block_size * sizeof(float);
+	r.diffused = static_cast<float*>(arena_alloc(memory, block_bytes));
+	r.modulation = static_cast<float*>(arena_alloc(memory, block_bytes));
+	return ok && r.diffused && r.modulation;
+}
+
+void float_reverb_process(float_reverb& r, float** in_out, size_t block_size)
+{
+	const float kap = r.diffusion;
+	const float klp = r.lp;
+	const float krt = r.reverb_time;
+	const float amount = r.amount;
+	const float gain = r.input_gain;
+
+	float* diffused = r.diffused;
+	float* modulation = r.modulation;
+	const uint32_t start = r.write_ptr;
+
+	// the lfos move every 32 samples, like the ones of the clouds fx engine. ap1 is
+	// smeared inside the loop, reading taps as close as 10 samples, so it runs one sample
+	// at a time.
+	uint32_t w = start;
+	for (size_t i = 0; i < block_size; i++) {
+		++w;
+		if ((w & 31) == 0) {
+			r.lfo_value[0] = r.lfo[0].Next();
+			r.lfo_value[1] = r.lfo[1].Next();
+		}
+		modulation[i] = kDel2Tap + kDel2Modulation * r.lfo_value[1];
+
+		float_reverb_line& ap1 = r.ap[0];
+		const float smear = 10.0f + 60.0f * r.lfo_value[0];
+		const uint32_t integral = (uint32_t)smear;
+		const float a = line_read(ap1, w, integral);
+		const float b = line_read(ap1, w, integral + 1);
+		ap1.data[(w - 100) & ap1.mask] = a + (b - a) * (smear - integral);
+
+		float acc = (in_out[0][i] + in_out[1][i]) * gain + kAntiDenormal;
+		const float tail = line_read(ap1, w, kApLength[0] - 1);
+		acc += tail * kap;
+		ap1.data[w & ap1.mask] = acc;
+		diffused[i] = acc * -kap + tail;
+	}
+
+	// the remaining diffusers are longer than a block, so none of them reads what it
+	// writes in the same block and each one can run over the whole block at once
+	for (int n = 1; n < 4; n++) {
+		float_reverb_line& ap = r.ap[n];
+		w = start;
+		for (size_t i = 0; i < block_size; i++) {
+			++w;
+			const float tail = line_read(ap, w, kApLength[n] - 1);
+			const float acc = diffused[i] + tail * kap;
+			ap.data[w & ap.mask] = acc;
+			diffused[i] = acc * -kap + tail;
+		}
+	}
+
+	// main loop, left branch in lane 0 and right branch in lane 1. the left branch feeds
+	// back from the modulated end of the right delay and the right branch from the end
+	// of the left delay. the allpass coefficients have opposite signs in the two branches.
+	const v2sf ka = {-kap, kap};
+	const v2sf kb = {kap, -kap};
+	v2sf lp_state = {r.lp_decay[0], r.lp_decay[1]};
+
+	w = start;
+	for (size_t i = 0; i < block_size; i++) {
+		++w;
+		const v2sf feedback = {line_interpolate_lane(r.loop_delay, w, modulation[i], 1),
+							   line_read_lane(r.loop_delay, w, kDel1Length - 1, 0)};
+		v2sf acc = diffused[i] + feedback * krt;
+
+		lp_state += klp * (acc - lp_state);
+		acc = lp_state;
+
+		const v2sf ra = loop_ap_read(r.loop_ap_a, w, kLoopApALength);
+		acc += ra * ka;
+		line_write_lanes(r.loop_ap_a, w, acc);
+		acc = acc * -ka + ra;
+
+		const v2sf rb = loop_ap_read(r.loop_ap_b, w, kLoopApBLength);
+		acc += rb * kb;
+		line_write_lanes(r.loop_ap_b, w, acc);
+		acc = acc * -kb + rb;
+
+		line_write_lanes(r.loop_delay, w, acc);
+		const v2sf wet = acc * 2.0f;
+
+		in_out[0][i] += (wet[0] - in_out[0][i]) * amount;
+		in_out[1][i] += (wet[1] - in_out[1][i]) * amount;
+	}
+
+	r.lp_decay[0] = lp_state[0];
+	r.lp_decay[1] = lp_state[1];
+	r.write_ptr = w;
+}
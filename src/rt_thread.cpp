@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#endif
+
+#include "rt_thread.hpp"
+
+rt_thread_result rt_thread_setup(const rt_thread_options& o)
+{
+	rt_thread_result r;
+
+#if defined(__linux__)
+	if (o.cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(o.cpu, &set);
+		r.pinned = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+	}
+
+	if (o.priority > 0) {
+		sched_param param {};
+		param.sched_priority = o.priority;
+		r.priority = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+	}
+#endif
+
+	if (o.flush_denormals) r.flush_denormals = rt_flush_denormals(true);
+	return r;
+}
+
+bool rt_thread_avoid(const std::vector<int>& cpus)
+{
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	const long online = sysconf(_SC_NPROCESSORS_ONLN);
+	for (int cpu = 0; cpu < online && cpu < CPU_SETSIZE; cpu++)
+		if (std::find(cpus.begin(), cpus.end(), cpu) == cpus.end()) CPU_SET(cpu, &set);
+	if (CPU_COUNT(&set) == 0) return false;
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpus;
+	return false;
+#endif
+}
+
+static const char* outcome(bool ok) { return ok ? "ok" : "failed"; }
+
+void rt_thread_print(const char* name, const rt_thread_options& o,
+					 const rt_thread_result& r, FILE* f)
+{
+	const char* separator = " ";
+	fprintf(f, "%s:", name);
+	if (o.priority > 0) {
+		fprintf(f, "%spriority %d %s", separator, o.priority, outcome(r.priority));
+		separator = ", ";
+	}
+	if (o.cpu >= 0) {
+		fprintf(f, "%scpu %d %s", separator, o.cpu, outcome(r.pinned));
+		separator = ", ";
+	}
+	if (o.flush_denormals)
+		fprintf(f, "%sflush denormals %s", separator, outcome(r.flush_denormals));
+	fprintf(f, "\n");
+}
+
+bool rt_flush_denormals(bool on)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	// flush-to-zero for results, denormals-are-zero for inputs
+	const unsigned int bits = 0x8040;
+	_mm_setcsr(on ? (_mm_getcsr() | bits) : (_mm_getcsr() & ~bits));
+	return true;
+#elif defined(__aarch64__)
+	// FZ, which covers both
+	const unsigned long bit = 1ul << 24;
+	unsigned long fpcr;
+	asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+	fpcr = on ? (fpcr | bit) : (fpcr & ~bit);
+	asm volatile("msr fpcr, %0" : : "r"(fpcr));
+	return true;
+#else
+	(void)on;
+	return false;
+#endif
+}
+
+bool rt_lock_memory(bool& future)
+{
+	// locking future mappings under a limit would make allocations fail once it is
+	// reached, so those are only locked without one
+	rlimit limit;
+	future = getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY;
+	const int flags = future ? (MCL_CURRENT | MCL_FUTURE) : MCL_CURRENT;
+	if (mlockall(flags) == 0) return true;
+	future = false;
+	return false;
+}
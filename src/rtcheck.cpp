@@ -0,0 +1,246 @@
+#ifdef FLECHTBOX_RTCHECK
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+
+#include "rtcheck.hpp"
+
+#if !defined(__GLIBC__)
+#error "FLECHTBOX_RTCHECK needs glibc"
+#endif
+
+// glibc's own allocator entry points, so the interposers below need no dlsym for these
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+// only the first few violations get a backtrace, the rest are counted
+static const long kMaxReports = 20;
+
+static __thread int rt_depth = 0;
+static __thread bool in_report = false;
+static std::atomic<long> violations {0};
+
+typedef int (*mutex_lock_fn)(pthread_mutex_t*);
+typedef int (*nanosleep_fn)(const timespec*, timespec*);
+typedef int (*clock_nanosleep_fn)(clockid_t, int, const timespec*, timespec*);
+typedef int (*usleep_fn)(useconds_t);
+typedef unsigned int (*sleep_fn)(unsigned int);
+typedef ssize_t (*read_fn)(int, void*, size_t);
+typedef ssize_t (*write_fn)(int, const void*, size_t);
+typedef int (*cond_wait_fn)(pthread_cond_t*, pthread_mutex_t*);
+typedef int (*cond_timedwait_fn)(pthread_cond_t*, pthread_mutex_t*, const timespec*);
+typedef int (*sem_wait_fn)(sem_t*);
+typedef int (*sem_timedwait_fn)(sem_t*, const timespec*);
+
+static mutex_lock_fn real_mutex_lock = nullptr;
+static nanosleep_fn real_nanosleep = nullptr;
+static clock_nanosleep_fn real_clock_nanosleep = nullptr;
+static usleep_fn real_usleep = nullptr;
+static sleep_fn real_sleep = nullptr;
+static read_fn real_read = nullptr;
+static write_fn real_write = nullptr;
+static cond_wait_fn real_cond_wait = nullptr;
+static cond_timedwait_fn real_cond_timedwait = nullptr;
+static sem_wait_fn real_sem_wait = nullptr;
+static sem_timedwait_fn real_sem_timedwait = nullptr;
+
+template <typename F>
+static F resolve(F& fn, const char* name)
+{
+	if (!fn) fn = reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+	return fn;
+}
+
+// plain dlsym finds the oldest version of the condition variable functions, whose
+// pthread_cond_t layout differs from the one the program was built against
+template <typename F>
+static F resolve_cond(F& fn, const char* name)
+{
+#if defined(__x86_64__)
+	if (!fn) fn = reinterpret_cast<F>(dlvsym(RTLD_NEXT, name, "GLIBC_2.3.2"));
+#endif
+	return resolve(fn, name);
+}
+
+// reports go through the real write, so they don't count as violations themselves
+static void write_str(const char* s)
+{
+	(void)!resolve(real_write, "write")(STDERR_FILENO, s, strlen(s));
+}
+
+static inline void rt_violation(const char* what)
+{
+	if (rt_depth == 0 || in_report) return;
+	in_report = true;
+
+	const long n = violations.fetch_add(1) + 1;
+	if (n <= kMaxReports) {
+		write_str("rt violation: ");
+		write_str(what);
+		write_str(" inside a real-time section\n");
+
+		void* frames[32];
+		int depth = backtrace(frames, 32);
+		backtrace_symbols_fd(frames, depth, STDERR_FILENO);
+
+		if (n == kMaxReports) write_str("rt violation: further reports suppressed\n");
+	}
+
+	in_report = false;
+}
+
+void rt_check_init()
+{
+	resolve(real_mutex_lock, "pthread_mutex_lock");
+	resolve(real_nanosleep, "nanosleep");
+	resolve(real_clock_nanosleep, "clock_nanosleep");
+	resolve(real_usleep, "usleep");
+	resolve(real_sleep, "sleep");
+	resolve(real_read, "read");
+	resolve(real_write, "write");
+	resolve_cond(real_cond_wait, "pthread_cond_wait");
+	resolve_cond(real_cond_timedwait, "pthread_cond_timedwait");
+	resolve(real_sem_wait, "sem_wait");
+	resolve(real_sem_timedwait, "sem_timedwait");
+
+	// the first backtrace loads the unwinder, which allocates
+	void* frames[4];
+	backtrace(frames, 4);
+}
+
+void rt_section_enter() { rt_depth++; }
+
+void rt_section_leave() { rt_depth--; }
+
+long rt_check_violations() { return violations.load(); }
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+	rt_violation("malloc");
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size)
+{
+	rt_violation("calloc");
+	return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+	rt_violation("realloc");
+	return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+	rt_violation("memalign");
+	return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+	rt_violation("aligned_alloc");
+	return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+	rt_violation("posix_memalign");
+	void* p = __libc_memalign(alignment, size);
+	if (!p) return ENOMEM;
+	*ptr = p;
+	return 0;
+}
+
+void free(void* ptr)
+{
+	if (ptr) rt_violation("free");
+	__libc_free(ptr);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+	rt_violation("pthread_mutex_lock");
+	return resolve(real_mutex_lock, "pthread_mutex_lock")(mutex);
+}
+
+int nanosleep(const timespec* req, timespec* rem)
+{
+	rt_violation("nanosleep");
+	return resolve(real_nanosleep, "nanosleep")(req, rem);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const timespec* req, timespec* rem)
+{
+	rt_violation("clock_nanosleep");
+	return resolve(real_clock_nanosleep, "clock_nanosleep")(clock, flags, req, rem);
+}
+
+int usleep(useconds_t usec)
+{
+	rt_violation("usleep");
+	return resolve(real_usleep, "usleep")(usec);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+	rt_violation("sleep");
+	return resolve(real_sleep, "sleep")(seconds);
+}
+
+ssize_t read(int fd, void* buf, size_t count)
+{
+	rt_violation("read");
+	return resolve(real_read, "read")(fd, buf, count);
+}
+
+ssize_t write(int fd, const void* buf, size_t count)
+{
+	rt_violation("write");
+	return resolve(real_write, "write")(fd, buf, count);
+}
+
+int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
+{
+	rt_violation("pthread_cond_wait");
+	return resolve_cond(real_cond_wait, "pthread_cond_wait")(cond, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex,
+						   const timespec* abstime)
+{
+	rt_violation("pthread_cond_timedwait");
+	return resolve_cond(real_cond_timedwait, "pthread_cond_timedwait")(cond, mutex,
+																		abstime);
+}
+
+int sem_wait(sem_t* sem)
+{
+	rt_violation("sem_wait");
+	return resolve(real_sem_wait, "sem_wait")(sem);
+}
+
+int sem_timedwait(sem_t* sem, const timespec* abstime)
+{
+	rt_violation("sem_timedwait");
+	return resolve(real_sem_timedwait, "sem_timedwait")(sem, abstime);
+}
+}
+
+#endif
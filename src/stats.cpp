@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <ctime>
+
+#include "stats.hpp"
+
+// smoothing of the displayed load, per callback
+static const float kLoadSmoothing = 0.05f;
+
+uint64_t stats_now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// raises a to at least v. the ui may reset it concurrently.
+static void atomic_max(std::atomic<float>& a, float v)
+{
+	float current = a.load(std::memory_order_relaxed);
+	while (v > current &&
+		   !a.compare_exchange_weak(current, v, std::memory_order_relaxed)) {}
+}
+
+void stats_record(audio_stats& s, uint64_t start, unsigned long frames, double samplerate,
+				  bool underflow, bool overflow, double latency)
+{
+	if (frames == 0) return;
+
+	const double render_ns = (double)(stats_now() - start);
+	const double buffer_ns = frames * 1e9 / samplerate;
+	const float load = (float)(render_ns / buffer_ns);
+
+	const int bin = std::min((int)(load / STATS_LOAD_BIN_WIDTH), STATS_LOAD_BINS - 1);
+	s.load_histogram[bin].fetch_add(1, std::memory_order_relaxed);
+	s.callbacks.fetch_add(1, std::memory_order_relaxed);
+	if (load > 1.f) s.late.fetch_add(1, std::memory_order_relaxed);
+	if (underflow) s.underflows.fetch_add(1, std::memory_order_relaxed);
+	if (overflow) s.overflows.fetch_add(1, std::memory_order_relaxed);
+
+	// only the audio thread writes these two
+	const float smoothed = s.load.load(std::memory_order_relaxed);
+	s.load.store(smoothed + (load - smoothed) * kLoadSmoothing, std::memory_order_relaxed);
+	if (load > s.max_load.load(std::memory_order_relaxed))
+		s.max_load.store(load, std::memory_order_relaxed);
+
+	atomic_max(s.peak_load, load);
+
+	if (latency >= 0.0) s.output_latency.store(latency, std::memory_order_relaxed);
+}
+
+float stats_take_peak(audio_stats& s)
+{
+	return s.peak_load.exchange(0.f, std::memory_order_relaxed);
+}
+
+// upper edge of the bin that holds the given fraction of all callbacks
+static float histogram_percentile(const audio_stats& s, uint64_t total, double fraction)
+{
+	const uint64_t rank = (uint64_t)(total * fraction);
+	uint64_t count = 0;
+	for (int b = 0; b < STATS_LOAD_BINS; b++) {
+		count += s.load_histogram[b].load(std::memory_order_relaxed);
+		if (count > rank) return (b + 1) * STATS_LOAD_BIN_WIDTH;
+	}
+	return STATS_LOAD_BINS * STATS_LOAD_BIN_WIDTH;
+}
+
+void stats_print(const audio_stats& s, FILE* f)
+{
+	const uint64_t total = s.callbacks.load(std::memory_order_relaxed);
+
+	fprintf(f, "callbacks:      %llu\n", (unsigned long long)total);
+	fprintf(f, "late:           %llu\n",
+			(unsigned long long)s.late.load(std::memory_order_relaxed));
+	fprintf(f, "underflows:     %llu\n",
+			(unsigned long long)s.underflows.load(std::memory_order_relaxed));
+	fprintf(f, "overflows:      %llu\n",
+			(unsigned long long)s.overflows.load(std::memory_order_relaxed));
+	fprintf(f, "max load:       %.1f %%\n",
+			s.max_load.load(std::memory_order_relaxed) * 100.f);
+	const double latency = s.output_latency.load(std::memory_order_relaxed);
+	if (latency > 0.0) fprintf(f, "output latency: %.2f ms\n", latency * 1000.0);
+	if (total == 0) return;
+
+	fprintf(f, "load p50 < %.0f %%, p99 < %.0f %%, p99.9 < %.0f %%\n",
+			histogram_percentile(s, total, 0.5) * 100.f,
+			histogram_percentile(s, total, 0.99) * 100.f,
+			histogram_percentile(s, total, 0.999) * 100.f);
+
+	// one row per bin, up to the highest bin in use
+	int last = 0;
+	for (int b = 0; b < STATS_LOAD_BINS; b++)
+		if (s.load_histogram[b].load(std::memory_order_relaxed) > 0) last = b;
+
+	for (int b = 0; b <= last; b++) {
+		const uint64_t n = s.load_histogram[b].load(std::memory_order_relaxed);
+		const int width = (int)(n * 50 / total);
+		if (b == STATS_LOAD_BINS - 1)
+			fprintf(f, "  >= %3.0f %%    %10llu ", b * STATS_LOAD_BIN_WIDTH * 100.f,
+					(unsigned long long)n);
+		else
+			fprintf(f, "  %3.0f - %3.0f %% %10llu ", b * STATS_LOAD_BIN_WIDTH * 100.f,
+					(b + 1) * STATS_LOAD_BIN_WIDTH * 100.f, (unsigned long long)n);
+		for (int i = 0; i < width; i++) fputc('#', f);
+		fputc('\n', f);
+	}
+}
@@ -0,0 +1,175 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "trace.hpp"
+
+// events in the ring, about 2.5 MB. at a 64 frame buffer the audio thread records some
+// 3000 events per second, the writer empties the ring every 10 ms.
+static const size_t kRingSize = 1 << 16;
+static const auto kFlushInterval = std::chrono::milliseconds(10);
+
+struct trace_event {
+	const char* name;
+	const char* arg_name;
+	int64_t arg;
+	uint64_t start;
+	uint64_t duration; // UINT64_MAX for instant events
+	trace_thread thread;
+};
+
+// bounded multi producer queue after dmitry vyukov. every slot carries a sequence
+// number that says whether it is free for the producer at position pos (seq == pos)
+// or holds the event for the consumer (seq == pos + 1).
+struct trace_slot {
+	std::atomic<uint64_t> seq;
+	trace_event event;
+};
+
+std::atomic<bool> trace_active {false};
+
+// never freed, a producer may still be writing a last event while tracing stops
+static std::vector<trace_slot> ring;
+alignas(64) static std::atomic<uint64_t> ring_head {0}; // next slot to write
+alignas(64) static uint64_t ring_tail = 0;				  // next slot to read, writer only
+static std::atomic<uint64_t> dropped {0};
+
+static FILE* file = nullptr;
+static uint64_t time_origin = 0;
+static bool first_event = true;
+static std::thread writer;
+static std::atomic<bool> writer_quit {false};
+
+static void trace_push(const trace_event& e)
+{
+	if (ring.empty()) return;
+
+	const uint64_t mask = ring.size() - 1;
+	uint64_t pos = ring_head.load(std::memory_order_relaxed);
+	trace_slot* slot;
+	for (;;) {
+		slot = &ring[pos & mask];
+		const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+		const int64_t diff = (int64_t)(seq - pos);
+		if (diff == 0) {
+			if (ring_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		} else {
+			pos = ring_head.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->event = e;
+	slot->seq.store(pos + 1, std::memory_order_release);
+}
+
+static bool trace_pop(trace_event& e)
+{
+	trace_slot& slot = ring[ring_tail & (ring.size() - 1)];
+	if (slot.seq.load(std::memory_order_acquire) != ring_tail + 1) return false;
+
+	e = slot.event;
+	slot.seq.store(ring_tail + ring.size(), std::memory_order_release);
+	ring_tail++;
+	return true;
+}
+
+static void write_event(const trace_event& e)
+{
+	// chrome wants microseconds
+	const double ts = (int64_t)(e.start - time_origin) / 1000.0;
+
+	fprintf(file, first_event ? "\n" : ",\n");
+	first_event = false;
+
+	if (e.duration == UINT64_MAX)
+		fprintf(file, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,"
+					  "\"tid\":%d",
+				e.name, ts, (int)e.thread);
+	else
+		fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,"
+					  "\"tid\":%d",
+				e.name, ts, e.duration / 1000.0, (int)e.thread);
+
+	if (e.arg_name) fprintf(file, ",\"args\":{\"%s\":%lld}", e.arg_name, (long long)e.arg);
+	fprintf(file, "}");
+}
+
+static void write_thread_name(trace_thread thread, const char* name)
+{
+	fprintf(file, first_event ? "\n" : ",\n");
+	first_event = false;
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+				  "\"args\":{\"name\":\"%s\"}}",
+			(int)thread, name);
+}
+
+static void drain()
+{
+	trace_event e;
+	while (trace_pop(e)) write_event(e);
+}
+
+bool trace_start(const char* path)
+{
+	file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "trace: could not open %s for writing\n", path);
+		return false;
+	}
+
+	ring = std::vector<trace_slot>(kRingSize);
+	for (size_t i = 0; i < ring.size(); i++) ring[i].seq.store(i, std::memory_order_relaxed);
+
+	time_origin = stats_now();
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	write_thread_name(TRACE_AUDIO, "audio");
+	write_thread_name(TRACE_UI, "ui");
+	write_thread_name(TRACE_UI_REDRAW, "ui redraw");
+
+	writer_quit = false;
+	writer = std::thread([] {
+		while (!writer_quit.load(std::memory_order_relaxed)) {
+			drain();
+			std::this_thread::sleep_for(kFlushInterval);
+		}
+	});
+
+	trace_active.store(true, std::memory_order_release);
+	return true;
+}
+
+void trace_stop()
+{
+	if (!file) return;
+
+	trace_active.store(false, std::memory_order_relaxed);
+	writer_quit = true;
+	writer.join();
+	drain();
+
+	fprintf(file, "\n],\"otherData\":{\"dropped_events\":%llu}}\n",
+			(unsigned long long)dropped.load(std::memory_order_relaxed));
+	fclose(file);
+	file = nullptr;
+
+	if (dropped > 0)
+		fprintf(stderr, "trace: %llu events dropped\n", (unsigned long long)dropped.load());
+}
+
+void trace_record_complete(const char* name, trace_thread thread, uint64_t start,
+						   uint64_t end, const char* arg_name, int64_t arg)
+{
+	if (!trace_active.load(std::memory_order_relaxed)) return;
+	trace_push({name, arg_name, arg, start, end - start, thread});
+}
+
+void trace_record_instant(const char* name, trace_thread thread, const char* arg_name,
+						  int64_t arg)
+{
+	trace_push({name, arg_name, arg, stats_now(), UINT64_MAX, thread});
+}
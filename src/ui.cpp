@@ -6,6 +6,11 @@
 #include <ftxui/dom/direction.hpp>
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/screen/color.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
@@ -13,57 +18,167 @@
 
 #include "controls.hpp"
 #include "dsp.hpp"
+#include "engines.hpp"
+#include "patterns.hpp"
+#include "project.hpp"
+#include "trace.hpp"
 #include "ui.hpp"
 
 using namespace ftxui;
 using namespace std;
 
-const std::vector<std::string> engines = {
-	"classic waveshapes",
-	"phase distortion",
-	"fm 1",
-	"fm 2",
-	"fm 3",
-	"wave terrain",
-	"string machine",
-	"arpeggiator",
-	"virtual analog",
-	"asymmetric triangle",
-	"2 sine waves",
-	"formants",
-	"additive sines",
-	"wavetable",
-	"chords",
-	"speech",
-	"sawtooth swarm",
-	"filtered noise",
-	"dust noise",
-	"rings a",
-	"rings b",
-	"kick",
-	"snare",
-	"hihat",
-};
-
 const std::vector<std::string> pb_directions = {"forward", "backward", "pendulum",
 												"random"};
 
-void ui_run(ftxui::ScreenInteractive& screen, std::shared_ptr<flechtbox_dsp> dsp)
+// the clock divisions, in the order of clock_division
+const std::vector<std::string> division_names = {"1/1", "1/2", "1/4", "1/8", "1/16",
+												 "1/32"};
+
+const std::array<const char*, PL_NUM_TARGETS> lock_target_names = {
+	"harmonics", "timbre", "morph", "decay", "engine"};
+
+// the plaits controls of a track that steps can lock. the controls edit one of these
+// instead of the parameters, lock_edit_sync moves the edits to where they belong.
+struct lock_edit {
+	float harmonics = 0.f;
+	float timbre = 0.f;
+	float morph = 0.f;
+	float decay = 0.f;
+	int engine = 0;
+};
+
+static std::array<float, PL_NUM_TARGETS> lock_edit_values(const lock_edit& e)
+{
+	return {e.harmonics, e.timbre, e.morph, e.decay, (float)e.engine};
+}
+
+// moves edits of the controls to the track settings, or with a held step to that
+// step's locks, then shows what the track plays on that step. run every frame, so
+// changes from elsewhere (loading, pattern switches) show up as well.
+static void lock_edit_sync(param_track& p, int held_step, lock_edit& shown, lock_edit& last)
+{
+	const auto edited = lock_edit_values(shown);
+	const auto previous = lock_edit_values(last);
+	std::array<float, PL_NUM_TARGETS> v = {p.harmonics, p.timbre, p.morph, p.decay,
+										   (float)p.engine};
+
+	for (int k = 0; k < PL_NUM_TARGETS; k++) {
+		if (edited[k] == previous[k]) continue;
+		if (held_step < 0) {
+			v[k] = edited[k];
+		} else {
+			p.locks.values[held_step][k] = edited[k];
+			p.locks.mask[held_step] |= 1u << k;
+		}
+	}
+
+	p.harmonics = v[PL_HARMONICS];
+	p.timbre = v[PL_TIMBRE];
+	p.morph = v[PL_MORPH];
+	p.decay = v[PL_DECAY];
+	p.engine = (int)v[PL_ENGINE];
+
+	if (held_step >= 0)
+		for (int k = 0; k < PL_NUM_TARGETS; k++)
+			if ((p.locks.mask[held_step] >> k) & 1) v[k] = p.locks.values[held_step][k];
+
+	shown = {v[PL_HARMONICS], v[PL_TIMBRE], v[PL_MORPH], v[PL_DECAY], (int)v[PL_ENGINE]};
+	last = shown;
+}
+
+// share of the dsp budget, as the profiler reports it
+static Element cpu_text(const char* label, float load)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), " %s %4.1f%% ", label, load * 100.f);
+	return text(buf);
+}
+
+void ui_run(ftxui::ScreenInteractive& screen, std::shared_ptr<flechtbox_dsp> dsp,
+			const char* project_path, int fps)
 {
-	std::vector<std::string> tab_values {
-		" T1 ", " T2 ", " T3 ", " T4 ", " T5 ", " T6 ", " T7 ", " T8 ", " T9 ", " MT ",
-	};
+	// a tab per track the dsp plays, the master tab last
+	const int num_tracks = dsp->num_tracks;
+	const int master_tab = num_tracks;
+	std::vector<std::string> tab_values;
+	for (int t = 0; t < num_tracks; t++)
+		tab_values.push_back(" T" + std::to_string(t + 1) + " ");
+	tab_values.push_back(" MT ");
+
+	// the controls edit the ui's own copy of the parameters. changes are sent to the
+	// audio thread once per frame, so the audio thread never sees a half written value.
+	parameters params;
+	parameters sent;
+	memcpy(&params, dsp->params, sizeof(parameters));
+	memcpy(&sent, &params, sizeof(parameters));
+
+	// playheads and clock gate, copied from dsp->display every frame
+	unsigned int pitch_pos = 0;
+	unsigned int octave_pos = 0;
+	unsigned int velocity_pos = 0;
+	std::array<unsigned int, MAX_TRACKS> track_pos {};
+	bool quarter_gate = false;
+
+	// load of the audio callback, copied from dsp->stats every frame. the peak is the
+	// highest load of the last full second.
+	float dsp_load = 0.f;
+	float dsp_peak = 0.f;
+	float window_peak = 0.f;
+	auto window_start = std::chrono::steady_clock::now();
+	unsigned long long xruns = 0;
+
+	// rolling averages of the profiler, copied every frame
+	std::array<float, MAX_TRACKS> track_load {};
+	std::array<float, PROFILE_NUM_STAGES> stage_load {};
+
+	// result of the last save or load
+	std::string project_status;
+
+	// tempo of the midi clock, copied every frame
+	float midi_tempo = 0.f;
+
+	// the pattern picked with [ and ]. it is queued as soon as the audio thread has
+	// switched to the previous one.
+	pattern_bank bank;
+	pattern_bank_init(bank, params);
+	int wanted_pattern = 0;
+	bool pattern_queued = false;
 
 	/////////////
 	// TOP BAR //
 	/////////////
 	int tab_selected = 0;
 	auto tab_toggle = Toggle(&tab_values, &tab_selected);
-	auto start_btn = Checkbox("run", &dsp->clock.running);
-	auto tempo_ctrl = FloatControl(&dsp->clock.tempo, "bpm:", 1.f, 20.f, 250.f,
+	auto start_btn = Checkbox("run", &params.master.running);
+	auto tempo_ctrl = FloatControl(&params.master.tempo, "bpm:", 1.f, 20.f, 250.f,
 								   {.horizontal = true, .border = false});
-	auto blinkenlight = Light(&dsp->clock.quarter_gate);
-	auto transport_ctrls = Container::Horizontal({tempo_ctrl, start_btn, blinkenlight});
+	auto blinkenlight = Light(&quarter_gate);
+	auto status = Renderer([&] { return text(project_status + " "); });
+	auto pattern_display = Renderer([&] {
+		std::string s = "pattern " + std::to_string(bank.current + 1);
+		if (wanted_pattern != bank.current) s += " > " + std::to_string(wanted_pattern + 1);
+		if (pattern_queued) s += " (next bar)";
+		return text(s + " ");
+	});
+	auto load_meter = Renderer([&] {
+		char buf[48];
+		snprintf(buf, sizeof(buf), "dsp %3.0f%% peak %3.0f%% xruns %llu ", dsp_load * 100.f,
+				 dsp_peak * 100.f, xruns);
+		auto meter = text(buf);
+		if (xruns > 0 || dsp_peak > 1.f) meter |= color(Color::Red);
+		return meter;
+	});
+	// with midi clock in, the tempo and start/stop controls are the master's
+	auto midi_display = Renderer([&] {
+		if (dsp->midi.mode == MIDI_SYNC_OFF) return emptyElement();
+		char buf[32];
+		snprintf(buf, sizeof(buf), "midi %s %5.1f ",
+				 dsp->midi.mode == MIDI_SYNC_IN ? "in" : "out", midi_tempo);
+		return text(buf);
+	});
+	auto transport_ctrls =
+		Container::Horizontal({status, pattern_display, load_meter, midi_display,
+							   tempo_ctrl, start_btn, blinkenlight});
 	auto top_container = Container::Horizontal({tab_toggle | flex, transport_ctrls});
 
 	////////////////////
@@ -76,16 +191,16 @@ void ui_run(ftxui::ScreenInteractive& screen, std::shared_ptr<flechtbox_dsp> dsp
 	// pitch sequencer
 	auto pitch_sliders_container = Container::Horizontal({});
 	for (int s = 0; s < NUM_STEPS; s++) {
-		auto slider = StepSliderBipolar(&dsp->pitch_sequence.data[s], s,
-										&dsp->pitch_sequence.current_pos,
-										&dsp->pitch_sequence.length, 1, -12, 12);
+		auto slider = StepSliderBipolar(&params.master.pitch_sequence.data[s], s,
+										&pitch_pos,
+										&params.master.pitch_sequence.length, 1, -12, 12);
 		pitch_sliders_container->Add(slider | flex);
 	}
 	auto pitch_length_ctrl =
-		IntegerControl(&dsp->pitch_sequence.length, "length", 1, 2, 10);
+		IntegerControl(&params.master.pitch_sequence.length, "length", 1, 2, 10);
 	auto pitch_settings_container = Container::Vertical({
 		pitch_length_ctrl,
-		Dropdown(&pb_directions, &dsp->pitch_sequence.playback_dir),
+		Dropdown(&pb_directions, &params.master.pitch_sequence.playback_dir),
 	});
 	auto master_pitch_container = Container::Horizontal(
 		{pitch_sliders_container | flex | border, pitch_settings_container | border});
@@ -93,16 +208,16 @@ void ui_run(ftxui::ScreenInteractive& screen, std::shared_ptr<flechtbox_dsp> dsp
 	// octave sliders
 	auto octave_sliders_container = Container::Horizontal({});
 	for (int s = 0; s < NUM_STEPS; s++) {
-		auto slider = StepSliderBipolar(&dsp->octave_sequence.data[s], s,
-										&dsp->octave_sequence.current_pos,
-										&dsp->octave_sequence.length, 12, -36, 36);
+		auto slider = StepSliderBipolar(&params.master.octave_sequence.data[s], s,
+										&octave_pos,
+										&params.master.octave_sequence.length, 12, -36, 36);
 		octave_sliders_container->Add(slider | flex);
 	}
 	auto octave_length_ctrl =
-		IntegerControl(&dsp->octave_sequence.length, "length", 1, 2, 10);
+		IntegerControl(&params.master.octave_sequence.length, "length", 1, 2, 10);
 	auto octave_settings_container = Container::Vertical({
 		octave_length_ctrl,
-		Dropdown(&pb_directions, &dsp->octave_sequence.playback_dir),
+		Dropdown(&pb_directions, &params.master.octave_sequence.playback_dir),
 	});
 	auto master_octave_container = Container::Horizontal(
 		{octave_sliders_container | flex | border, octave_settings_container | border});
@@ -110,56 +225,121 @@ void ui_run(ftxui::ScreenInteractive& screen, std::shared_ptr<flechtbox_dsp> dsp
 	// velocity sliders
 	auto velocity_sliders_container = Container::Horizontal({});
 	for (int s = 0; s < NUM_STEPS; s++) {
-		auto slider = StepSlider(&dsp->velocity_sequence.data[s], s,
-								 &dsp->velocity_sequence.current_pos,
-								 &dsp->velocity_sequence.length, 10);
+		auto slider = StepSlider(&params.master.velocity_sequence.data[s], s,
+								 &velocity_pos,
+								 &params.master.velocity_sequence.length, 10);
 		velocity_sliders_container->Add(slider | flex);
 	}
 	auto velocity_length_ctrl =
-		IntegerControl(&dsp->velocity_sequence.length, "length", 1, 2, 10);
+		IntegerControl(&params.master.velocity_sequence.length, "length", 1, 2, 10);
 	auto velocity_settings_container = Container::Vertical({
 		velocity_length_ctrl,
-		Dropdown(&pb_directions, &dsp->velocity_sequence.playback_dir),
+		Dropdown(&pb_directions, &params.master.velocity_sequence.playback_dir),
 	});
 	auto master_velocity_container =
 		Container::Horizontal({velocity_sliders_container | flex | border,
 							   velocity_settings_container | border});
 
+	auto stage_loads = Renderer([&] {
+		Elements stages;
+		for (int s = 0; s < PROFILE_NUM_STAGES; s++)
+			stages.push_back(cpu_text(profile_stage_name((profile_stage)s), stage_load[s]));
+		return hbox(stages);
+	});
+
+	// reverb, shared by all tracks, and the seed of the random draws
+	auto reverb_container = Container::Horizontal({
+		FloatControl(&params.reverb.input_gain, "reverb in") | flex,
+		FloatControl(&params.reverb.time, "time", 0.01f, 0.f, 0.95f) | flex,
+		FloatControl(&params.reverb.diffusion, "diffusion", 0.01f, 0.f, 0.95f) | flex,
+		FloatControl(&params.reverb.lp, "lp") | flex,
+		IntegerControl(&params.master.seed, "seed", 1, 0, 9999) | flex,
+	});
+
+	// delay, repeating every division of the tempo
+	auto delay_container = Container::Horizontal({
+		Dropdown(&division_names, &params.delay.division),
+		FloatControl(&params.delay.feedback, "feedback", 0.01f, 0.f, 0.95f) | flex,
+		FloatControl(&params.delay.lp, "lp") | flex,
+		FloatControl(&params.delay.level, "delay out") | flex,
+		Checkbox("ping-pong", &params.delay.ping_pong),
+	});
+
 	auto master_track_container = Container::Vertical({
 		master_pitch_container | flex,
 		master_octave_container | flex,
 		master_velocity_container | flex,
+		reverb_container | border,
+		delay_container | border,
+		stage_loads,
 	});
 
 	// SLAVE TRACKS
-	for (int t = 0; t < NUM_TRACKS; t++) {
+	// L on a step holds it: until L is pressed again, the plaits controls of the track
+	// record locks for that step instead of changing the track. C clears its locks.
+	// (l is taken, it moves the focus.)
+	std::array<lock_edit, MAX_TRACKS> lock_shown;
+	std::array<lock_edit, MAX_TRACKS> lock_last;
+	std::array<int, MAX_TRACKS> held_step;
+	held_step.fill(-1);
+	for (int t = 0; t < num_tracks; t++)
+		lock_edit_sync(params.tracks[t], -1, lock_shown[t], lock_last[t]);
+
+	for (int t = 0; t < num_tracks; t++) {
 		auto sliders_container = Container::Horizontal({});
 
 		for (int s = 0; s < NUM_STEPS; s++) {
-			auto slider = StepSlider(&dsp->tracks[t].sequencer.data[s], s,
-									 &dsp->tracks[t].sequencer.current_pos,
-									 &dsp->tracks[t].sequencer.length, 20);
+			auto slider = StepSlider(&params.tracks[t].sequence.data[s], s,
+									 &track_pos[t], &params.tracks[t].sequence.length,
+									 20, 0, 100, &params.tracks[t].locks.mask[s]);
+			slider |= CatchEvent([&, t, s](Event event) {
+				auto& p = params.tracks[t];
+				if (event == Event::Character('L')) {
+					// edits made so far belong to the old target
+					lock_edit_sync(p, held_step[t], lock_shown[t], lock_last[t]);
+					held_step[t] = (held_step[t] == s) ? -1 : s;
+					lock_edit_sync(p, held_step[t], lock_shown[t], lock_last[t]);
+					return true;
+				}
+				if (event == Event::Character('C')) {
+					p.locks.mask[s] = 0;
+					lock_edit_sync(p, held_step[t], lock_shown[t], lock_last[t]);
+					return true;
+				}
+				return false;
+			});
 			sliders_container->Add(slider | flex);
 		}
 
+		auto lock_status = Renderer([&, t] {
+			const int s = held_step[t];
+			if (s < 0) return text("");
+			std::string status = " step " + std::to_string(s + 1) + " held, locks:";
+			const uint32_t mask = params.tracks[t].locks.mask[s];
+			for (int k = 0; k < PL_NUM_TARGETS; k++)
+				if ((mask >> k) & 1) status += std::string(" ") + lock_target_names[k];
+			if (!mask) status += " none";
+			return text(status) | color(Color::Yellow);
+		});
+
 		auto harmonics_container = Container::Horizontal({
-			FloatControl(&dsp->tracks[t].harmonics, "harmonics") | flex,
-			FloatControl(&dsp->tracks[t].harmonics_rand_amt, "rand"),
+			FloatControl(&lock_shown[t].harmonics, "harmonics") | flex,
+			FloatControl(&params.tracks[t].harmonics_rand_amt, "rand"),
 		});
 
 		auto timbre_container = Container::Horizontal({
-			FloatControl(&dsp->tracks[t].timbre, "timbre") | flex,
-			FloatControl(&dsp->tracks[t].timbre_rand_amt, "rand"),
+			FloatControl(&lock_shown[t].timbre, "timbre") | flex,
+			FloatControl(&params.tracks[t].timbre_rand_amt, "rand"),
 		});
 
 		auto morph_container = Container::Horizontal({
-			FloatControl(&dsp->tracks[t].morph, "morph") | flex,
-			FloatControl(&dsp->tracks[t].morph_rand_amt, "rand"),
+			FloatControl(&lock_shown[t].morph, "morph") | flex,
+			FloatControl(&params.tracks[t].morph_rand_amt, "rand"),
 		});
 
 		auto lgp_ctrls = Container::Horizontal({
-			FloatControl(&dsp->tracks[t].plaits_patch.decay, "decay") | flex,
-			FloatControl(&dsp->tracks[t].plaits_patch.lpg_colour, "color") | flex,
+			FloatControl(&lock_shown[t].decay, "decay") | flex,
+			FloatControl(&params.tracks[t].lpg_colour, "color") | flex,
 		});
 
 		auto plaitsctrls_container = Container::Vertical({
@@ -167,21 +347,25 @@ void ui_run(ftxui::ScreenInteractive& screen, std::shared_ptr<flechtbox_dsp> dsp
 			timbre_container,
 			morph_container,
 			lgp_ctrls,
-			Dropdown(&engines, &dsp->tracks[t].plaits_patch.engine),
+			Container::Horizontal({
+				Dropdown(&engine_names, &lock_shown[t].engine) | flex,
+				Renderer([&, t] { return cpu_text("cpu", track_load[t]); }),
+			}),
 		});
 
 		auto trackctrls_container = Container::Vertical(
-			{IntegerControl(&dsp->tracks[t].sequencer.length, "sequence length", 1, 2,
+			{IntegerControl(&params.tracks[t].sequence.length, "sequence length", 1, 2,
 							10),
-			 Dropdown(&pb_directions, &dsp->tracks[t].sequencer.playback_dir),
-			 IntegerControl(&dsp->tracks[t].pitch, "root note", 1, 0, 96.f),
-			 Checkbox("mute", &dsp->tracks[t].muted)});
+			 Dropdown(&pb_directions, &params.tracks[t].sequence.playback_dir),
+			 IntegerControl(&params.tracks[t].pitch, "root note", 1, 0, 96.f),
+			 Checkbox("mute", &params.tracks[t].muted)});
 
 		auto globalctrls_container = Container::Vertical({
-			Checkbox("pitch", &dsp->tracks[t].global_pitch_enabled),
-			Checkbox("octave", &dsp->tracks[t].global_octave_enabled),
-			Checkbox("velocity", &dsp->tracks[t].global_velocity_enabled),
-			FloatControl(&dsp->tracks[t].reverb_send_amt, "reverb"),
+			Checkbox("pitch", &params.tracks[t].global_pitch_enabled),
+			Checkbox("octave", &params.tracks[t].global_octave_enabled),
+			Checkbox("velocity", &params.tracks[t].global_velocity_enabled),
+			FloatControl(&params.tracks[t].reverb_send_amt, "reverb"),
+			FloatControl(&params.tracks[t].delay_send_amt, "delay"),
 		});
 
 		auto settings_container = Container::Horizontal(
@@ -189,7 +373,8 @@ void ui_run(ftxui::ScreenInteractive& screen, std::shared_ptr<flechtbox_dsp> dsp
 			 globalctrls_container | border | flex});
 
 		auto track_container =
-			Container::Vertical({sliders_container | border | flex, settings_container});
+			Container::Vertical({sliders_container | border | flex, lock_status,
+								 settings_container});
 
 		track_tabs->Add(track_container);
 	}
@@ -197,7 +382,43 @@ void ui_run(ftxui::ScreenInteractive& screen, std::shared_ptr<flechtbox_dsp> dsp
 	track_tabs->Add(master_track_container);
 
 	auto main_container = Container::Vertical({top_container, track_tabs});
-	auto renderer = Renderer(main_container, [&top_container, &track_tabs] {
+	auto renderer = Renderer(main_container, [&] {
+		trace_scope trace("frame", TRACE_UI);
+
+		// send whatever the last events changed to the audio thread
+		for (int t = 0; t < num_tracks; t++)
+			lock_edit_sync(params.tracks[t], held_step[t], lock_shown[t], lock_last[t]);
+		if (wanted_pattern != bank.current)
+			pattern_queue(bank, wanted_pattern, params, sent, *dsp);
+		param_sync(params, sent, dsp->commands);
+		pattern_queued = dsp->pattern_busy.load(std::memory_order_acquire);
+
+		auto& d = dsp->display;
+		quarter_gate = d.quarter_gate.load(std::memory_order_relaxed);
+		pitch_pos = d.pitch_pos.load(std::memory_order_relaxed);
+		octave_pos = d.octave_pos.load(std::memory_order_relaxed);
+		velocity_pos = d.velocity_pos.load(std::memory_order_relaxed);
+		for (int t = 0; t < num_tracks; t++)
+			track_pos[t] = d.track_pos[t].load(std::memory_order_relaxed);
+
+		for (int t = 0; t < num_tracks; t++)
+			track_load[t] = dsp->profile.track_load[t].load(std::memory_order_relaxed);
+		for (int s = 0; s < PROFILE_NUM_STAGES; s++)
+			stage_load[s] = dsp->profile.stage_load[s].load(std::memory_order_relaxed);
+
+		midi_tempo = dsp->midi.tempo.load(std::memory_order_relaxed);
+
+		auto& s = dsp->stats;
+		dsp_load = s.load.load(std::memory_order_relaxed);
+		xruns = stats_xruns(s);
+		window_peak = std::max(window_peak, stats_take_peak(s));
+		const auto now = std::chrono::steady_clock::now();
+		if (now - window_start >= std::chrono::seconds(1)) {
+			dsp_peak = window_peak;
+			window_peak = 0.f;
+			window_start = now;
+		}
+
 		return vbox({
 				   top_container->Render(),
 				   separator(),
@@ -207,46 +428,77 @@ void ui_run(ftxui::ScreenInteractive& screen, std::shared_ptr<flechtbox_dsp> dsp
 	});
 
 	renderer |= CatchEvent([&](Event event) {
+		// save and load the project, the edits go out with the next frame
+		if (event == Event::CtrlS) {
+			const char* error = project_save(params, project_path);
+			project_status = error ? error : std::string("saved ") + project_path;
+			return true;
+		}
+		if (event == Event::CtrlO) {
+			const char* error = project_load(params, project_path);
+			project_status = error ? error : std::string("loaded ") + project_path;
+			return true;
+		}
+
 		// start / stop
 		if (event == Event::F1) {
-			dsp->clock.running = !dsp->clock.running;
+			params.master.running = !params.master.running;
 			return true;
 		}
 
-		// select tabs with keys 1 - 0
-		for (char num = '0'; num <= '9'; num++) {
+		// select the first nine tracks with keys 1 - 9 and the master with 0, step
+		// through all tabs with , and .
+		if (event == Event::Character('0')) {
+			tab_selected = master_tab;
+			return true;
+		}
+		for (char num = '1'; num <= '9'; num++) {
 			if (event == Event::Character(num)) {
-				tab_selected = (num == '0') ? 9 : (num - '1');
+				// keys past the last track do nothing
+				if (num - '1' < num_tracks) tab_selected = num - '1';
 				return true;
 			}
 		}
+		if (event == Event::Character(',') || event == Event::Character('.')) {
+			const int step = event == Event::Character('.') ? 1 : master_tab;
+			tab_selected = (tab_selected + step) % (master_tab + 1);
+			return true;
+		}
+
+		// pick the next pattern, or copy this one to the following slot
+		if (event == Event::Character('[') || event == Event::Character(']')) {
+			const int step = event == Event::Character(']') ? 1 : NUM_PATTERNS - 1;
+			wanted_pattern = (wanted_pattern + step) % NUM_PATTERNS;
+			return true;
+		}
+		if (event == Event::Character('p')) {
+			bank.patterns[(bank.current + 1) % NUM_PATTERNS] = params;
+			return true;
+		}
 
 		// mute selected track
-		if (event == Event::Character('m') && tab_selected <= 9) {
-			dsp->tracks[tab_selected].muted = !dsp->tracks[tab_selected].muted;
+		if (event == Event::Character('m') && tab_selected < num_tracks) {
+			params.tracks[tab_selected].muted = !params.tracks[tab_selected].muted;
 		}
 
 		return false;
 	});
 
-	// thread to poll dsp metronome for ui redraws
-	bool ui_running = true;
-	std::thread([&] {
-		bool gate_change = false;
-		while (ui_running) {
-			bool current_gate = dsp.get()->clock.thirtysecond_gate;
-			if (current_gate != gate_change) {
-				gate_change = current_gate;
-				screen.RequestAnimationFrame();
-				// screen.PostEvent(Event::Custom);
-			}
-			std::this_thread::sleep_for(std::chrono::milliseconds(2)); // adjust speed!
+	// redraws when the audio thread says something changed, at most fps times a
+	// second. the changes that come in during an interval go into the same frame.
+	auto& redraw = dsp->display.redraw;
+	std::thread redraw_thread([&] {
+		const auto interval = std::chrono::microseconds(1000000 / std::max(fps, 1));
+		while (redraw_signal_wait(redraw, interval)) {
+			trace_instant("redraw", TRACE_UI_REDRAW);
+			screen.RequestAnimationFrame();
 		}
-	}).detach();
+	});
 
 	screen.Loop(renderer);
 
-	ui_running = false;
+	redraw_signal_close(redraw);
+	redraw_thread.join();
 
 	printf("ui terminated\n");
 }
@@ -0,0 +1,161 @@
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "rt_thread.hpp"
+#include "workers.hpp"
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+// how long an idle worker spins before it sleeps, a few sub-blocks, so a running
+// stream wakes its workers without a system call
+static const auto kSpinTime = std::chrono::milliseconds(1);
+
+// blocks while p.generation is `seen`. it can return early, callers check again.
+static void generation_wait(worker_pool& p, uint32_t seen)
+{
+#if defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&p.generation), FUTEX_WAIT_PRIVATE,
+			seen, nullptr, nullptr, 0);
+#else
+	// no futex, a short nap keeps the core mostly free
+	(void)seen;
+	std::this_thread::sleep_for(std::chrono::microseconds(200));
+#endif
+}
+
+static void generation_wake(worker_pool& p)
+{
+#if defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&p.generation), FUTEX_WAKE_PRIVATE,
+			INT32_MAX, nullptr, nullptr, 0);
+#else
+	(void)p;
+#endif
+}
+
+// claims and runs jobs until none are left, returns the number of jobs run
+static int worker_pool_drain(worker_pool& p)
+{
+	int done = 0;
+	for (;;) {
+		const uint64_t t = p.ticket.fetch_add(1, std::memory_order_acq_rel);
+		const uint32_t job = (uint32_t)t;
+		const uint32_t num_jobs = (uint32_t)(t >> 32);
+		if (job >= num_jobs) break;
+
+		p.fn(p.ctx, (int)job);
+		done++;
+	}
+	if (done) p.jobs_done.fetch_add(done, std::memory_order_release);
+	return done;
+}
+
+static void worker_loop(worker_pool& p, rt_thread_options o,
+						std::promise<rt_thread_result> setup)
+{
+	setup.set_value(rt_thread_setup(o));
+
+	uint32_t seen = p.generation.load(std::memory_order_acquire);
+
+	while (!p.quit.load(std::memory_order_relaxed)) {
+		// spin for low wake-up latency while forks keep coming, then sleep until the
+		// next one. under SCHED_FIFO a yield would only let threads of the same priority
+		// run, so an idle worker has to block to leave its core to the rest.
+		const auto spin_end = std::chrono::steady_clock::now() + kSpinTime;
+		int spins = 0;
+		uint32_t gen;
+		while ((gen = p.generation.load(std::memory_order_acquire)) == seen) {
+			if (p.quit.load(std::memory_order_relaxed)) return;
+			if (++spins % 64 != 0 || std::chrono::steady_clock::now() < spin_end) {
+				cpu_relax();
+				continue;
+			}
+			// announced before the last look at `generation`, and the fork bumps it
+			// before it looks at `sleepers`, so one of the two sees the other
+			p.sleepers.fetch_add(1, std::memory_order_seq_cst);
+			if (p.generation.load(std::memory_order_seq_cst) == seen)
+				generation_wait(p, seen);
+			p.sleepers.fetch_sub(1, std::memory_order_relaxed);
+		}
+		seen = gen;
+
+		worker_pool_drain(p);
+	}
+}
+
+void worker_pool_start(worker_pool& p, int num_workers, worker_job_fn fn, void* ctx,
+					   const std::vector<int>& cpus, bool realtime)
+{
+	p.fn = fn;
+	p.ctx = ctx;
+	p.quit = false;
+
+	// reported from here rather than from the workers, which would write into the ui
+	// once it has taken the terminal. only under realtime or when something failed.
+	for (int i = 0; i < num_workers; i++) {
+		rt_thread_options o;
+		o.priority = realtime ? RT_AUDIO_PRIORITY - 1 : 0;
+		o.cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+		o.flush_denormals = realtime;
+
+		std::promise<rt_thread_result> setup;
+		auto result = setup.get_future();
+		p.threads.emplace_back(worker_loop, std::ref(p), o, std::move(setup));
+		const rt_thread_result r = result.get();
+
+		const bool failed = (o.priority > 0 && !r.priority) ||
+							(o.cpu >= 0 && !r.pinned) ||
+							(o.flush_denormals && !r.flush_denormals);
+		if (failed || realtime) {
+			char name[32];
+			snprintf(name, sizeof(name), "worker %d", i);
+			rt_thread_print(name, o, r, stderr);
+		}
+	}
+}
+
+void worker_pool_stop(worker_pool& p)
+{
+	p.quit = true;
+	p.generation.fetch_add(1, std::memory_order_seq_cst);
+	generation_wake(p);
+	for (auto& t : p.threads) t.join();
+	p.threads.clear();
+}
+
+worker_pool::~worker_pool() { worker_pool_stop(*this); }
+
+void worker_pool_fork(worker_pool& p, int num_jobs)
+{
+	// the ticket store publishes the job inputs to any thread that claims a job
+	p.jobs_done.store(0, std::memory_order_relaxed);
+	p.ticket.store((uint64_t)num_jobs << 32, std::memory_order_release);
+	p.generation.fetch_add(1, std::memory_order_seq_cst);
+	if (p.sleepers.load(std::memory_order_seq_cst) > 0) generation_wake(p);
+}
+
+void worker_pool_join(worker_pool& p, int num_jobs)
+{
+	worker_pool_drain(p);
+
+	while (p.jobs_done.load(std::memory_order_acquire) < num_jobs) cpu_relax();
+}